@@ -1,2 +0,0 @@
-#include <Arduino.h>
-#include <stdint.h>
\ No newline at end of file
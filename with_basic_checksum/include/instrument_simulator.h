@@ -1,8 +0,0 @@
-/* instrument_simulator.h
-Author:  Nevin Leh
-Date:    April 2020 */
-
-/********************
-Includes
-*********************/
-#include "instrument.h"
\ No newline at end of file
@@ -0,0 +1,255 @@
+/* alarm_bench.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Alarm modes under garbage input on the virtual clock. The uplink runs at line rate with full command ITFs
+alternating with ITFs whose commands are line noise, each of which raises a CCSDS alarm every few bytes and
+then fails its checksum. Each mode is set with K_INS_CMD_ALARM_MODE and run in turn. The bench reports the
+alarm packets and bytes on the line, and the occurrences they carry against the counts in status. Coalesced
+and token bucket modes must answer every good command with nothing dropped and report every occurrence.
+The token bucket must hold immediate alarms to its rate. A 60 s token period holds thousands of occurrences,
+sent when the next mode is set, and over the whole run every occurrence must be reported. Uncapped immediate
+alarms are run last for comparison.
+Before the modes, the alarm mode is changed from a batched ITF while coalesced alarms are held, and the batch
+must come out whole with every occurrence reported. Usage: alarm_bench [seconds per mode] */
+
+/********************
+Includes
+*********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "line_harness.h"
+
+/********************
+Constants
+*********************/
+const uint32_t K_BENCH_BAUD = 115200;
+const uint8_t K_BENCH_LOAD_ARGS = 20;             // Arguments per load command
+const uint32_t K_BENCH_DEFAULT_SECONDS = 10;
+const uint32_t K_BENCH_SETTLE_US = 2500000;       // Quiet time after a run, covers a window and a status
+
+/********************
+Structures
+*********************/
+typedef struct BenchMode {
+    const char *name;
+    uint8_t mode;                                  // ALARM_MODE
+    uint16_t period_ms;                            // Window or token period
+    bool checked;                                  // Must keep up with the line
+} BenchMode;
+
+typedef struct Tally {
+    uint64_t echoes;
+    uint64_t alarm_packets;
+    uint64_t alarm_bytes;
+    uint64_t occurrences;                          // Sum of the auxiliary bytes
+    uint16_t status_counts[ALARM_TYPES];           // Latest status
+} Tally;
+
+const BenchMode K_BENCH_MODES[] = {
+    {"coalesce per ITF", ALARM_COALESCE, 0, true},
+    {"coalesce 100 ms", ALARM_COALESCE, 100, true},
+    {"immediate 10 ms", ALARM_IMMEDIATE, 10, true},
+    {"immediate 60 s", ALARM_IMMEDIATE, 60000, false},     // Holds far more than one packet carries
+    {"immediate uncapped", ALARM_IMMEDIATE, 0, false},
+};
+
+/********************
+Global Variables
+*********************/
+SerialPort instrument_port;                      // Loopback the bench drives
+InstrumentSim instrument(instrument_port);
+LineHarness line;
+Tally tally = {};
+
+/**********************************************************************************************************************
+* Function      : void onFrame(const TlmFrame& frame)
+* Description   : Tallies the echoes, alarms and status off the line
+* Arguments     : const TlmFrame& frame
+* Returns       : none
+**********************************************************************************************************************/
+void onFrame(const TlmFrame &frame) {
+    TlmEcho echo;
+    TlmAlarm alarm;
+    TlmStatus status;
+    uint16_t offset = 0;
+    switch(frame.kind) {
+        case TLM_ECHO:
+            while(tlmDecodeEcho(frame, offset, echo)) {
+                tally.echoes++;
+            }
+            break;
+        case TLM_ALARM:
+            tlmDecodeAlarm(frame, alarm);
+            tally.alarm_packets++;
+            tally.alarm_bytes += frame.size;
+            tally.occurrences += alarm.aux;
+            break;
+        case TLM_STATUS:
+            tlmDecodeStatus(frame, status);
+            memcpy(tally.status_counts, status.alarm_counts, sizeof tally.status_counts);
+            break;
+        default:
+            break;
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : uint64_t raisedSince(const Tally& start)
+* Description   : Alarms status counted since start
+* Arguments     : const Tally& start
+* Returns       : uint64_t
+* Remarks       : The status counters are 16 bits, start must be less than 65536 of a type ago
+**********************************************************************************************************************/
+uint64_t raisedSince(const Tally &start) {
+    uint64_t raised = 0;
+    for(uint8_t type = 0; type < ALARM_TYPES; type++) {
+        raised += (uint16_t)(tally.status_counts[type] - start.status_counts[type]);
+    }
+    return raised;
+}
+
+/**********************************************************************************************************************
+* Function      : bool batchModeChange(const uint8_t* garbage, size_t garbage_size)
+* Description   : Changes the alarm mode from inside a batched ITF while coalesced alarms are held
+* Arguments     : const uint8_t* garbage, size_t garbage_size - a noise ITF to leave alarms pending
+* Returns       : bool - false if the batch came out corrupt or an echo or occurrence went missing
+* Remarks       : The held alarms go out on the mode change, after the batch of the ITF that made it
+**********************************************************************************************************************/
+bool batchModeChange(const uint8_t *garbage, size_t garbage_size) {
+    Tally start = tally;
+    uint64_t start_bad = line.bad_checks;
+
+    uint8_t batch_on[K_CMD_ECHO_MODE_ARGS] = {1};
+    uint8_t batch_off[K_CMD_ECHO_MODE_ARGS] = {0};
+    uint8_t window_args[K_CMD_ALARM_MODE_ARGS] = {ALARM_COALESCE, 1000 >> 8, 1000 & 0xFF};
+    uint8_t per_itf_args[K_CMD_ALARM_MODE_ARGS] = {ALARM_COALESCE, 0, 0};
+    ItfCommand on_cmd = {K_INS_CMD_ECHO_MODE, 0, K_CMD_ECHO_MODE_ARGS, batch_on};
+    ItfCommand window_cmd = {K_INS_CMD_ALARM_MODE, 0, K_CMD_ALARM_MODE_ARGS, window_args};
+    ItfCommand change_cmds[3] = {{0x80, 0, 0, NULL},
+                                 {K_INS_CMD_ALARM_MODE, 0, K_CMD_ALARM_MODE_ARGS, per_itf_args},
+                                 {0x81, 0, 0, NULL}};
+    ItfCommand off_cmd = {K_INS_CMD_ECHO_MODE, 0, K_CMD_ECHO_MODE_ARGS, batch_off};
+
+    // The window is well over the time the noise and the change take on the line
+    lineQueueFrame(line, &on_cmd, 1);
+    lineQueueFrame(line, &window_cmd, 1);
+    line.uplink.insert(line.uplink.end(), garbage, garbage + garbage_size);
+    lineQueueFrame(line, change_cmds, 3);
+    lineQueueFrame(line, &off_cmd, 1);
+    lineRunFor(line, K_BENCH_SETTLE_US);
+
+    uint64_t echoes = tally.echoes - start.echoes;
+    uint64_t reported = tally.occurrences - start.occurrences;
+    uint64_t raised = raisedSince(start);
+    uint64_t bad = line.bad_checks - start_bad;
+    printf("%-20s %10llu %10u %10llu %10s %10llu %10llu %8s\n", "batch mode change", (unsigned long long)echoes, 6,
+           (unsigned long long)(tally.alarm_packets - start.alarm_packets), "-", (unsigned long long)reported,
+           (unsigned long long)raised, "-");
+    if(bad != 0) {
+        printf("bad checksums: %llu\n", (unsigned long long)bad);
+    }
+    return echoes == 6 && bad == 0 && raised > 0 && reported == raised;
+}
+
+int main(int argc, char **argv) {
+    uint32_t seconds = argc > 1 ? strtoul(argv[1], NULL, 0) : K_BENCH_DEFAULT_SECONDS;
+
+    lineBegin(line, instrument_port, instrument, onFrame);
+    instrument.linkBegin(K_BENCH_BAUD, LINK_8O1);
+    instrument.statusBegin();
+
+    // Full frame of commands with handlers that only echo, and the same frame with noise for commands
+    uint8_t load_args[K_BENCH_LOAD_ARGS] = {0};
+    ItfCommand load_cmds[K_MAX_CMDS];
+    for(uint8_t c = 0; c < K_MAX_CMDS; c++) {
+        load_cmds[c] = {(uint8_t)(0x80 + c), 0, K_BENCH_LOAD_ARGS, load_args};
+    }
+    uint8_t load_frame[K_MAX_PACKET_SIZE];
+    uint8_t garbage_frame[K_MAX_PACKET_SIZE];
+    size_t load_size = buildItfFrame(load_frame, 0, load_cmds, K_MAX_CMDS, true);
+    memcpy(garbage_frame, load_frame, load_size);
+    uint32_t noise = 0x2545F491;
+    for(size_t i = K_ITF_TIME_END; i < load_size - 2; i++) {
+        noise = noise * 1103515245 + 12345;
+        garbage_frame[i] = noise >> 24;
+    }
+    line.load_bytes.assign(load_frame, load_frame + load_size);
+    line.load_bytes.insert(line.load_bytes.end(), garbage_frame, garbage_frame + load_size);
+
+    printf("load: %zu byte ITFs at %u baud 8O1, good and noise alternating, %u s per mode\n", load_size,
+           K_BENCH_BAUD, seconds);
+    printf("%-20s %10s %10s %10s %10s %10s %10s %8s\n", "mode", "echoes", "expected", "alarm tlm", "alarm B/s",
+           "reported", "raised", "dropped");
+
+    bool pass = batchModeChange(garbage_frame, load_size);
+    Tally first = tally;
+    Tally last = tally;
+    uint64_t total_raised = 0;
+    for(const BenchMode &mode : K_BENCH_MODES) {
+        uint8_t mode_args[K_CMD_ALARM_MODE_ARGS] = {mode.mode, (uint8_t)(mode.period_ms >> 8),
+                                                    (uint8_t)mode.period_ms};
+        ItfCommand mode_cmd = {K_INS_CMD_ALARM_MODE, 0, K_CMD_ALARM_MODE_ARGS, mode_args};
+        lineQueueFrame(line, &mode_cmd, 1);
+        lineRunFor(line, K_BENCH_SETTLE_US);
+
+        Tally start = tally;
+        uint64_t start_cycles = line.load_cycles;
+        uint32_t start_dropped = instrument.txQueueDropped();
+        line.load = true;
+        lineRunFor(line, seconds * 1000000);
+        line.load = false;
+        lineRunFor(line, K_BENCH_SETTLE_US);
+
+        uint64_t echoes = tally.echoes - start.echoes;
+        uint64_t expected = (line.load_cycles - start_cycles) * K_MAX_CMDS;
+        uint64_t reported = tally.occurrences - start.occurrences;
+        uint64_t raised = raisedSince(start);
+        total_raised += raisedSince(last);
+        last = tally;
+        uint64_t packets = tally.alarm_packets - start.alarm_packets;
+        uint32_t dropped = instrument.txQueueDropped() - start_dropped;
+        printf("%-20s %10llu %10llu %10llu %10.0f %10llu %10llu %8u\n", mode.name, (unsigned long long)echoes,
+               (unsigned long long)expected, (unsigned long long)packets,
+               (double)(tally.alarm_bytes - start.alarm_bytes) / seconds, (unsigned long long)reported,
+               (unsigned long long)raised, dropped);
+
+        if(mode.checked && (echoes != expected || dropped != 0 || reported != raised)) {
+            pass = false;
+        }
+        // Bucket starts full and refills once a period over the run and the settle
+        uint64_t window_us = (uint64_t)seconds * 1000000 + K_BENCH_SETTLE_US;
+        if(mode.mode == ALARM_IMMEDIATE && mode.period_ms > 0 &&
+           packets > window_us / (mode.period_ms * 1000) + K_ALARM_BURST) {
+            pass = false;
+        }
+    }
+
+    // Counts held by one mode go out when the next is set, over the whole run none may be lost
+    uint8_t end_args[K_CMD_ALARM_MODE_ARGS] = {ALARM_COALESCE, 0, 0};
+    ItfCommand end_cmd = {K_INS_CMD_ALARM_MODE, 0, K_CMD_ALARM_MODE_ARGS, end_args};
+    lineQueueFrame(line, &end_cmd, 1);
+    lineRunFor(line, K_BENCH_SETTLE_US);
+    total_raised += raisedSince(last);
+    uint64_t total_reported = tally.occurrences - first.occurrences;
+    printf("%-20s %10s %10s %10llu %10s %10llu %10llu %8s\n", "all modes", "-", "-",
+           (unsigned long long)(tally.alarm_packets - first.alarm_packets), "-", (unsigned long long)total_reported,
+           (unsigned long long)total_raised, "-");
+    if(total_reported != total_raised) {
+        pass = false;
+    }
+
+    // Every frame off the line must pass the checksum
+    if(line.bad_checks != 0) {
+        printf("bad checksums: %llu\n", (unsigned long long)line.bad_checks);
+        pass = false;
+    }
+
+    if(!pass) {
+        printf("FAIL\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,31 @@
+/* bench_rng.h
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Random stream for the host benches and the corpus generator. splitmix64 gives the same stream for a seed on
+every host, so corpora and bench inputs are reproducible. Each caller keeps its own state. */
+
+#ifndef BENCH_RNG_H
+#define BENCH_RNG_H
+
+/********************
+Includes
+*********************/
+#include <stdint.h>
+
+/**********************************************************************************************************************
+* Function      : uint64_t rngNext(uint64_t& state)
+* Description   : splitmix64, the same stream for a seed on every host
+* Arguments     : uint64_t& state - the seed to start with, advanced by each call
+* Returns       : uint64_t
+**********************************************************************************************************************/
+inline uint64_t rngNext(uint64_t &state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+#endif
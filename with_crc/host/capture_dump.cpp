@@ -0,0 +1,118 @@
+/* capture_dump.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Reads a capture ring written through captureMapFile(), or copied off the Teensy's PSRAM, in place. Prints a
+summary per instrument and direction. With a record count, the newest records are printed as well, TX frames
+with their APID. Fails unless the records are in time order and span some time.
+Usage: capture_dump <file> [records to print] */
+
+/********************
+Includes
+*********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "capture_log.h"
+
+/********************
+Constants
+*********************/
+const uint8_t K_DUMP_SOURCES = 8;                 // Instruments a sketch can run
+const uint8_t K_DUMP_HEX_BYTES = 24;              // Payload bytes printed per record
+
+/********************
+Structures
+*********************/
+typedef struct DirTotals {
+    uint64_t records;
+    uint64_t bytes;
+} DirTotals;
+
+/**********************************************************************************************************************
+* Function      : void printRecord(const CaptureRecord* record, const uint8_t* payload, uint32_t first_us)
+* Description   : One line per record, time from the oldest record
+* Arguments     : const CaptureRecord* record, const uint8_t* payload, uint32_t first_us
+* Returns       : none
+**********************************************************************************************************************/
+void printRecord(const CaptureRecord *record, const uint8_t *payload, uint32_t first_us) {
+    printf("%12.6f s  %u %s %4u B", (record->time_us - first_us) * 1e-6, record->source,
+           record->direction == CAPTURE_RX ? "rx" : "tx", record->length);
+    if(record->direction == CAPTURE_TX && record->length >= 8) {
+        printf("  apid 0x%03X", ((payload[6] & 0x07) << 8) | payload[7]);
+    }
+    printf(" ");
+    for(uint16_t i = 0; i < record->length && i < K_DUMP_HEX_BYTES; i++) {
+        printf(" %02X", payload[i]);
+    }
+    printf("%s\n", record->length > K_DUMP_HEX_BYTES ? " ..." : "");
+}
+
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        printf("usage: capture_dump <file> [records to print]\n");
+        return 1;
+    }
+    uint32_t show = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+
+    const CaptureHeader *log = captureOpenFile(argv[1]);
+    if(log == NULL) {
+        printf("FAIL: %s is not a version %u capture\n", argv[1], K_CAPTURE_VERSION);
+        return 1;
+    }
+
+    DirTotals totals[K_DUMP_SOURCES][2] = {};
+    uint32_t first_us = 0;
+    uint32_t last_us = 0;
+    uint32_t read = 0;
+    bool ordered = true;
+    const CaptureRecord *record;
+    const uint8_t *payload;
+    CaptureCursor cursor = captureBegin(log);
+    while(captureNext(cursor, record, payload)) {
+        if((const uint8_t *)payload + record->length > cursor.area + cursor.capacity ||
+           record->direction > CAPTURE_TX) {
+            printf("FAIL: record %u is corrupt\n", read);
+            return 1;
+        }
+        if(read == 0) {
+            first_us = record->time_us;
+        }else if((int32_t)(record->time_us - last_us) < 0) {
+            ordered = false;
+        }
+        last_us = record->time_us;
+        DirTotals &dir = totals[record->source % K_DUMP_SOURCES][record->direction];
+        dir.records++;
+        dir.bytes += record->length;
+        if(read + show >= log->count) {
+            printRecord(record, payload, first_us);
+        }
+        read++;
+    }
+
+    printf("capture     : %s, %u byte ring, %u records held\n", argv[1], log->capacity, log->count);
+    printf("appended    : %u records, %llu payload bytes, %u overwritten\n", log->appended,
+           (unsigned long long)log->payload_bytes, log->overwritten);
+    printf("span        : %.6f s\n", (last_us - first_us) * 1e-6);
+    for(uint8_t source = 0; source < K_DUMP_SOURCES; source++) {
+        const DirTotals *dir = totals[source];
+        if(dir[CAPTURE_RX].records + dir[CAPTURE_TX].records == 0) {
+            continue;
+        }
+        printf("instrument %u: rx %llu chunks %llu bytes, tx %llu frames %llu bytes\n", source,
+               (unsigned long long)dir[CAPTURE_RX].records, (unsigned long long)dir[CAPTURE_RX].bytes,
+               (unsigned long long)dir[CAPTURE_TX].records, (unsigned long long)dir[CAPTURE_TX].bytes);
+    }
+
+    if(read != log->count || !ordered) {
+        printf("FAIL: %u of %u records read%s\n", read, log->count, ordered ? "" : ", out of time order");
+        return 1;
+    }
+    // A ring of records all stamped at once was written without a running clock
+    if(read > 1 && last_us == first_us) {
+        printf("FAIL: %u records with one time stamp\n", read);
+        return 1;
+    }
+    return 0;
+}
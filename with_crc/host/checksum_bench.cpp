@@ -0,0 +1,248 @@
+/* checksum_bench.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Runs the same uplink and downlink load through InstrumentDriver built with each checksum policy. RX pushes
+ITF frames sealed with the policy through getData() and checks every echo comes back, then one frame per
+policy is corrupted to check it is caught. TX streams survey science through txDrain() with the line
+unpaced. Every telemetry frame is checked against the policy. Usage: checksum_bench [frames] [science frames] */
+
+/********************
+Includes
+*********************/
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "itf_frame.h"
+
+/********************
+Constants
+*********************/
+const uint32_t K_BENCH_VARIANTS = 64;            // Distinct frames cycled through
+const uint64_t K_BENCH_DEFAULT_FRAMES = 500000;
+const uint32_t K_BENCH_DEFAULT_SCIENCE = 10000;
+// A trailer reading 0x1B00 after a tenth command is taken as an eleventh, any policy can produce one
+const uint8_t K_BENCH_MAX_CMDS = K_MAX_CMDS - 1;
+
+/********************
+Structures
+*********************/
+typedef struct PolicyResult {
+    double rx_seconds;
+    uint64_t rx_bytes;
+    double tx_seconds;
+    uint64_t tx_bytes;
+} PolicyResult;
+
+/********************
+Global Variables
+*********************/
+uint8_t base_frames[K_BENCH_VARIANTS][K_MAX_PACKET_SIZE];
+size_t base_sizes[K_BENCH_VARIANTS];
+uint8_t base_cmds[K_BENCH_VARIANTS];
+
+// Telemetry seen on the loopback by the policy being run
+std::vector<uint8_t> wire;                       // Bytes off the line not yet checked
+uint64_t tlm_echo = 0;
+uint64_t tlm_checksum_alarms = 0;
+uint64_t tlm_science = 0;
+uint64_t tlm_bad = 0;                            // Frames whose trailer disagrees with the policy
+
+/**********************************************************************************************************************
+* Function      : void buildFrames()
+* Description   : Generates frame variants with 1 to K_BENCH_MAX_CMDS commands of varying argument counts
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+void buildFrames() {
+    uint8_t args[K_MAX_CMD_SIZE];
+    for(int i = 0; i < K_MAX_CMD_SIZE; i++) {
+        args[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    ItfCommand cmds[K_MAX_CMDS];
+    for(uint32_t v = 0; v < K_BENCH_VARIANTS; v++) {
+        uint8_t cmd_count = 1 + v % K_BENCH_MAX_CMDS;
+        for(uint8_t c = 0; c < cmd_count; c++) {
+            cmds[c] = {(uint8_t)(0x80 + v + c), (uint8_t)(c & 0x01), (uint8_t)((v * 3 + c * 5) % 16), args};
+        }
+        base_cmds[v] = cmd_count;
+        base_sizes[v] = buildItfFrame(base_frames[v], v, cmds, cmd_count, true);
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : template<class CHECKSUM> void sealFrame(uint8_t* frame, size_t size)
+* Description   : Rewrites the trailer of a frame with the policy's checksum
+* Arguments     : uint8_t* frame, size_t size
+* Returns       : none
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void sealFrame(uint8_t *frame, size_t size) {
+    uint16_t check = CHECKSUM::update(CHECKSUM::seed, &frame[K_TLM_CRC_OFFSET], size - K_TLM_CRC_OFFSET - 2);
+    frame[size - 2] = (check >> 8) & 0xFF;
+    frame[size - 1] = check & 0xFF;
+}
+
+/**********************************************************************************************************************
+* Function      : template<class CHECKSUM> void checkWire(SerialPort& port)
+* Description   : Moves the TX capture onto the wire buffer and checks and counts every complete frame in it
+* Arguments     : SerialPort& port
+* Returns       : none
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void checkWire(SerialPort &port) {
+    wire.insert(wire.end(), port.txData(), port.txData() + port.txSize());
+    port.clearTx();
+
+    size_t pos = 0;
+    while(pos + K_TLM_HEADER_SIZE <= wire.size()) {
+        const uint8_t *tlm = &wire[pos];
+        size_t pack_size = (((tlm[4] & 0x1F) << 8) | tlm[5]) + K_INS_DATA_LEN_OFFSET;
+        if(pos + pack_size > wire.size()) {
+            break;
+        }
+
+        // Echoes of an odd argument count move the checksum up a byte and follow it with the pad, which is
+        // checksummed as a zero in front of it
+        uint16_t apid = ((tlm[6] & 0x07) << 8) | tlm[7];
+        size_t check_at = pack_size - 2;
+        uint16_t check = CHECKSUM::update(CHECKSUM::seed, &tlm[K_TLM_CRC_OFFSET], check_at - K_TLM_CRC_OFFSET);
+        if(apid == K_ECHO_APID && check != ((tlm[check_at] << 8) | tlm[check_at + 1])) {
+            static const uint8_t pad = 0x00;
+            check_at--;
+            check = CHECKSUM::update(CHECKSUM::seed, &tlm[K_TLM_CRC_OFFSET], check_at - K_TLM_CRC_OFFSET);
+            check = CHECKSUM::update(check, &pad, 1);
+        }
+        if(check != ((tlm[check_at] << 8) | tlm[check_at + 1])) {
+            tlm_bad++;
+        }
+        if(apid == K_ECHO_APID) {
+            tlm_echo++;
+        }else if(apid == K_ALARM_APID && tlm[18] == ITF_CHECKSUM + 1) {
+            tlm_checksum_alarms++;
+        }else if(apid == K_SCIENCE_APID) {
+            tlm_science++;
+        }
+        pos += pack_size;
+    }
+    wire.erase(wire.begin(), wire.begin() + pos);
+}
+
+/**********************************************************************************************************************
+* Function      : template<class CHECKSUM> bool runPolicy(const char* name, uint64_t frames, uint32_t science,
+*                                                          PolicyResult& result)
+* Description   : Times RX and TX through a driver built with CHECKSUM and checks what it sent
+* Arguments     : const char* name, uint64_t frames - ITFs to receive, uint32_t science - science frames to send,
+*                 PolicyResult& result
+* Returns       : bool - false if any check failed
+**********************************************************************************************************************/
+template <class CHECKSUM>
+bool runPolicy(const char *name, uint64_t frames, uint32_t science, PolicyResult &result) {
+    // Each policy gets its own instrument, they are too large for the stack
+    static SerialPort port;
+    static InstrumentDriver<CHECKSUM> instrument(port);
+    static uint8_t bench_frames[K_BENCH_VARIANTS][K_MAX_PACKET_SIZE];
+
+    wire.clear();
+    tlm_echo = tlm_checksum_alarms = tlm_science = tlm_bad = 0;
+    for(uint32_t v = 0; v < K_BENCH_VARIANTS; v++) {
+        memcpy(bench_frames[v], base_frames[v], base_sizes[v]);
+        sealFrame<CHECKSUM>(bench_frames[v], base_sizes[v]);
+    }
+
+    // Uplink
+    uint64_t commands = 0;
+    result.rx_bytes = 0;
+    result.rx_seconds = 0;
+    for(uint64_t i = 0; i < frames; i++) {
+        uint32_t v = i % K_BENCH_VARIANTS;
+        port.feed(bench_frames[v], base_sizes[v]);
+        auto start = std::chrono::steady_clock::now();
+        instrument.getData();
+        instrument.txDrain();
+        result.rx_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        checkWire<CHECKSUM>(port);
+        result.rx_bytes += base_sizes[v];
+        commands += base_cmds[v];
+    }
+    bool pass = tlm_echo == commands && tlm_checksum_alarms == 0;
+
+    // A flipped argument bit must be caught by every policy that checks
+    uint8_t corrupt[K_MAX_PACKET_SIZE];
+    memcpy(corrupt, bench_frames[1], base_sizes[1]);
+    corrupt[base_sizes[1] - 3] ^= 0x01;
+    port.feed(corrupt, base_sizes[1]);
+    instrument.getData();
+    instrument.txDrain();
+    checkWire<CHECKSUM>(port);
+    pass = pass && tlm_checksum_alarms == (CHECKSUM::verified ? 1 : 0);
+
+    // Downlink, full size survey frames on an unpaced line
+    uint8_t surv_args[K_CMD_MODE_ARGS] = {1, (uint8_t)(K_MAX_TLM_SIZE >> 8), (uint8_t)K_MAX_TLM_SIZE};
+    ItfCommand surv = {K_INS_CMD_SURVEY, 0, K_CMD_MODE_ARGS, surv_args};
+    uint8_t frame[K_MAX_PACKET_SIZE];
+    size_t size = buildItfFrame(frame, 0, &surv, 1, true);
+    sealFrame<CHECKSUM>(frame, size);
+    port.feed(frame, size);
+    instrument.getData();
+
+    uint32_t sent_start = instrument.scienceFramesSent();
+    uint32_t tx_start = instrument.txBytesWritten();
+    result.tx_seconds = 0;
+    while(instrument.scienceFramesSent() - sent_start < science) {
+        auto drain_start = std::chrono::steady_clock::now();
+        instrument.txDrain();
+        result.tx_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - drain_start).count();
+        checkWire<CHECKSUM>(port);
+    }
+    result.tx_bytes = instrument.txBytesWritten() - tx_start;
+    pass = pass && tlm_science >= science && tlm_bad == 0;
+
+    printf("%-10s %10.2f %10.0f %10.3f %10.0f %8llu %8llu %6llu  %s\n", name,
+           result.rx_seconds * 1e9 / result.rx_bytes, result.rx_bytes / result.rx_seconds / 1e6,
+           result.tx_seconds * 1e9 / result.tx_bytes, result.tx_bytes / result.tx_seconds / 1e6,
+           (unsigned long long)tlm_echo, (unsigned long long)tlm_checksum_alarms, (unsigned long long)tlm_bad,
+           pass ? "ok" : "FAIL");
+    return pass;
+}
+
+int main(int argc, char **argv) {
+    uint64_t frames = K_BENCH_DEFAULT_FRAMES;
+    uint32_t science = K_BENCH_DEFAULT_SCIENCE;
+    if(argc > 1) {
+        frames = strtoull(argv[1], NULL, 0);
+    }
+    if(argc > 2) {
+        science = strtoul(argv[2], NULL, 0);
+    }
+
+    buildFrames();
+    printf("%llu ITFs up, %u science frames of %u bytes down\n", (unsigned long long)frames, science,
+           K_MAX_TLM_SIZE);
+    printf("%-10s %10s %10s %10s %10s %8s %8s %6s\n", "policy", "rx ns/B", "rx MB/s", "tx ns/B", "tx MB/s",
+           "echoes", "caught", "bad");
+
+    PolicyResult results[4];
+    bool pass = runPolicy<ChecksumNone>("none", frames, science, results[0]);
+    pass = runPolicy<ChecksumBasic>("basic", frames, science, results[1]) && pass;
+    pass = runPolicy<ChecksumCrcTable>("crc table", frames, science, results[2]) && pass;
+    pass = runPolicy<ChecksumCrcSlice>("crc slice", frames, science, results[3]) && pass;
+
+    // Cost of each check over none, the rest of the driver is the same code
+    for(int p = 1; p < 4; p++) {
+        static const char *const names[4] = {"none", "basic", "crc table", "crc slice"};
+        printf("%-10s %+.2f ns/B rx, %+.3f ns/B tx over none\n", names[p],
+               results[p].rx_seconds * 1e9 / results[p].rx_bytes - results[0].rx_seconds * 1e9 / results[0].rx_bytes,
+               results[p].tx_seconds * 1e9 / results[p].tx_bytes - results[0].tx_seconds * 1e9 / results[0].tx_bytes);
+    }
+
+    if(!pass) {
+        printf("FAIL\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,268 @@
+/* corpus_gen.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Writes a reproducible uplink corpus for corpus_replay: valid ITFs mixed with bit errors, out of range lengths,
+0x1900/0x1B00 APID variants, truncations and idle fill, see CORPUS_KIND. Every corruption is built so its
+effect on getData() is known, the counts go in the CorpusHeader. Usage: corpus_gen <file> [records] [seed] */
+
+/********************
+Includes
+*********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_rng.h"
+#include "itf_corpus.h"
+
+/********************
+Constants
+*********************/
+const uint64_t K_GEN_DEFAULT_RECORDS = 1000000;
+const uint8_t K_GEN_MAX_ARGS = 20;               // Keeps command length bytes below 0x1B
+const uint8_t K_GEN_MAX_PAD = 64;
+const uint8_t K_GEN_WEIGHTS[CORPUS_KINDS] = {70, 8, 5, 8, 5, 4};   // Percent of records by CORPUS_KIND
+const uint16_t K_GEN_TIME_APIDS[] = {0x1901, 0x1800, 0x1A00, 0x0900};
+const uint16_t K_GEN_CMD_APIDS[] = {0x1B01, 0x1A00, 0x1F00, 0x0B00};
+const char *const K_GEN_KIND_NAMES[CORPUS_KINDS] = {"valid", "bad crc", "bad length", "bad apid", "truncated",
+                                                    "padding"};
+
+/********************
+Global Variables
+*********************/
+uint64_t rng_state = 0;
+FILE *out_file = NULL;
+CorpusHeader header;
+
+// Frame being built
+uint8_t frame[K_MAX_PACKET_SIZE];
+size_t frame_size = 0;
+uint8_t frame_cmds = 0;
+size_t cmd_offsets[K_MAX_CMDS];
+
+uint32_t rngBelow(uint32_t n) {
+    return rngNext(rng_state) % n;
+}
+
+// Never 0x1B, so a header search can't start a command inside a packet
+uint8_t payloadByte() {
+    uint8_t value;
+    do {
+        value = (uint8_t)rngNext(rng_state);
+    } while(value == 0x1B);
+    return value;
+}
+
+// Never 0xFE or 0xC8, so fill can't start or finish a sync
+uint8_t idleByte() {
+    uint8_t value;
+    do {
+        value = (uint8_t)rngNext(rng_state);
+    } while(value == 0xFE || value == 0xC8);
+    return value;
+}
+
+/**********************************************************************************************************************
+* Function      : void buildFrame()
+* Description   : Builds a valid ITF with a time packet and 1 to K_MAX_CMDS commands into frame
+* Arguments     : none
+* Returns       : none
+* Remarks       : Opcodes are 0x80 and up so no handler changes the driver mode mid corpus
+**********************************************************************************************************************/
+void buildFrame() {
+    uint8_t args[K_MAX_CMDS][K_GEN_MAX_ARGS];
+    ItfCommand cmds[K_MAX_CMDS];
+
+    frame_cmds = 1 + rngBelow(K_MAX_CMDS);
+    size_t offset = K_ITF_TIME_END;
+    for(uint8_t c = 0; c < frame_cmds; c++) {
+        cmds[c].opcode = (uint8_t)(0x80 + rngBelow(0x80));
+        cmds[c].macro = rngBelow(2);
+        cmds[c].arg_count = rngBelow(K_GEN_MAX_ARGS + 1);
+        for(uint8_t a = 0; a < cmds[c].arg_count; a++) {
+            args[c][a] = payloadByte();
+        }
+        cmds[c].args = args[c];
+        cmd_offsets[c] = offset;
+        offset += cmds[c].arg_count + K_ITF_CMD_OVERHEAD;
+    }
+
+    uint32_t time = ((uint32_t)payloadByte() << 24) | ((uint32_t)payloadByte() << 16) | (payloadByte() << 8) |
+                    payloadByte();
+    frame_size = buildItfFrame(frame, time, cmds, frame_cmds, true);
+}
+
+// Recomputes the frame CRC after a header has been changed
+void setCrc() {
+    uint16_t check = crcUpdate(CRC_SEED, &frame[4], frame_size - 6);
+    frame[frame_size - 2] = (check >> 8) & 0xFF;
+    frame[frame_size - 1] = check & 0xFF;
+}
+
+// A CRC of 0x1B00 after a tenth command is taken as an eleventh header, the FSM alarms ITF_LENGTH and drops
+// the frame, so the generator never ends a frame with one
+bool crcIsHeader() {
+    return frame[frame_size - 2] == 0x1B && frame[frame_size - 1] == 0x00;
+}
+
+bool hasSync(const uint8_t *data, size_t len) {
+    uint32_t window = 0;
+    for(size_t i = 0; i < len; i++) {
+        window = (window << 8) | data[i];
+        if(i >= 3 && window == SYNC) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**********************************************************************************************************************
+* Function      : void writeRecord(CORPUS_KIND kind)
+* Description   : Builds one record, adds what getData() must answer with to the header and writes it out
+* Arguments     : CORPUS_KIND kind
+* Returns       : none
+**********************************************************************************************************************/
+void writeRecord(CORPUS_KIND kind) {
+    switch(kind) {
+    case CORPUS_VALID:
+        do {
+            buildFrame();
+        } while(crcIsHeader());
+        header.echoes += frame_cmds;
+        break;
+
+    case CORPUS_BAD_CRC:
+        do {
+            // Last command trailer or the CRC, bytes the FSM never reads as structure
+            buildFrame();
+            size_t pos = frame_size - 1 - rngBelow(K_ITF_CMD_OVERHEAD - 14 + 2);
+            frame[pos] ^= 1 << rngBelow(8);
+        } while(crcIsHeader());
+        header.checksum_alarms++;
+        break;
+
+    case CORPUS_BAD_LENGTH:
+        do {
+            buildFrame();
+            uint16_t len;
+            if(rngBelow(2)) {
+                len = rngBelow(K_MIN_PACKET_SIZE - K_INS_DATA_LEN_OFFSET + 1);
+            }else {
+                len = K_MAX_PACKET_SIZE - K_INS_DATA_LEN_OFFSET +
+                      rngBelow(0x2000 - (K_MAX_PACKET_SIZE - K_INS_DATA_LEN_OFFSET));
+            }
+            frame[4] = (len >> 8) & 0x1F;
+            frame[5] = len & 0xFF;
+        // After the alarm the rest of the frame is searched for sync
+        } while(hasSync(&frame[1], frame_size - 1));
+        header.length_alarms++;
+        break;
+
+    case CORPUS_BAD_APID: {
+        bool time_target;
+        do {
+            buildFrame();
+            time_target = rngBelow(2);
+            size_t pos;
+            uint16_t apid;
+            if(time_target) {
+                pos = K_ITF_PACKET_START;
+                apid = K_GEN_TIME_APIDS[rngBelow(sizeof(K_GEN_TIME_APIDS) / sizeof(K_GEN_TIME_APIDS[0]))];
+            }else {
+                pos = cmd_offsets[rngBelow(frame_cmds)];
+                apid = K_GEN_CMD_APIDS[rngBelow(sizeof(K_GEN_CMD_APIDS) / sizeof(K_GEN_CMD_APIDS[0]))];
+            }
+            frame[pos] = (apid >> 8) & 0xFF;
+            frame[pos + 1] = apid & 0xFF;
+            setCrc();
+        } while(crcIsHeader());
+        // The FSM searches past the bad packet, a bad command is the only one lost
+        header.echoes += frame_cmds - (time_target ? 0 : 1);
+        header.ccsds_alarms_min++;
+        break;
+    }
+
+    case CORPUS_TRUNCATED:
+        do {
+            // Cut after the length and before the CRC high byte, the FSM counts idle fill up to the length
+            buildFrame();
+            size_t cut = K_ITF_PACKET_START + rngBelow(frame_size - 1 - K_ITF_PACKET_START);
+            memset(&frame[cut], rngBelow(2) ? 0x00 : 0xFF, frame_size - cut);
+        } while(crcUpdate(CRC_SEED, &frame[4], frame_size - 4) == 0x0000);
+        header.checksum_alarms++;
+        break;
+
+    case CORPUS_PADDING:
+        frame_size = 1 + rngBelow(K_GEN_MAX_PAD);
+        for(size_t i = 0; i < frame_size; i++) {
+            frame[i] = idleByte();
+        }
+        break;
+
+    default:
+        return;
+    }
+
+    fwrite(frame, 1, frame_size, out_file);
+    header.stream_bytes += frame_size;
+    header.records[kind]++;
+}
+
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        printf("usage: corpus_gen <file> [records] [seed]\n");
+        return 1;
+    }
+    uint64_t records = K_GEN_DEFAULT_RECORDS;
+    uint64_t seed = 1;
+    if(argc > 2) {
+        records = strtoull(argv[2], NULL, 0);
+    }
+    if(argc > 3) {
+        seed = strtoull(argv[3], NULL, 0);
+    }
+
+    out_file = fopen(argv[1], "wb");
+    if(out_file == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    // Header is rewritten with the totals at the end
+    memset(&header, 0, sizeof(header));
+    header.magic = K_CORPUS_MAGIC;
+    header.version = K_CORPUS_VERSION;
+    header.header_size = sizeof(CorpusHeader);
+    header.seed = seed;
+    fwrite(&header, 1, sizeof(header), out_file);
+
+    rng_state = seed;
+    uint32_t weight_total = 0;
+    for(uint8_t kind = 0; kind < CORPUS_KINDS; kind++) {
+        weight_total += K_GEN_WEIGHTS[kind];
+    }
+    for(uint64_t r = 0; r < records; r++) {
+        uint32_t pick = rngBelow(weight_total);
+        uint8_t kind = 0;
+        while(pick >= K_GEN_WEIGHTS[kind]) {
+            pick -= K_GEN_WEIGHTS[kind];
+            kind++;
+        }
+        writeRecord((CORPUS_KIND)kind);
+    }
+
+    fseek(out_file, 0, SEEK_SET);
+    fwrite(&header, 1, sizeof(header), out_file);
+    if(fclose(out_file) != 0) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    printf("corpus      : %s, %llu records, %llu bytes, seed %llu\n", argv[1], (unsigned long long)records,
+           (unsigned long long)header.stream_bytes, (unsigned long long)seed);
+    for(uint8_t kind = 0; kind < CORPUS_KINDS; kind++) {
+        printf("%-12s: %llu\n", K_GEN_KIND_NAMES[kind], (unsigned long long)header.records[kind]);
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+/* corpus_replay.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Replays a corpus_gen file through getData() as fast as the host can go. The file is mmapped and fed to the
+loopback port a chunk at a time, each chunk is followed by txDrain() and the telemetry is tallied by APID and
+alarm type, each alarm packet counting the occurrences in its auxiliary byte. Echoes, ITF_CHECKSUM and
+ITF_LENGTH must match the header exactly. The telemetry digest depends on the corpus and the chunk size, pass
+the digest of a known good build to pin the output byte for byte.
+Usage: corpus_replay <file> [chunk bytes] [digest] */
+
+/********************
+Includes
+*********************/
+#include <chrono>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "itf_corpus.h"
+
+/********************
+Constants
+*********************/
+// Small enough that an ITF's echoes and the alarms of one chunk fit the TX queue together
+const size_t K_REPLAY_DEFAULT_CHUNK = 16;
+const uint64_t K_REPLAY_FNV_SEED = 0xCBF29CE484222325ULL;
+const uint64_t K_REPLAY_FNV_PRIME = 0x100000001B3ULL;
+
+/********************
+Global Variables
+*********************/
+SerialPort instrument_port;                      // Loopback the bench drives
+InstrumentSim instrument(instrument_port);
+
+uint64_t tlm_echo = 0;
+uint64_t tlm_alarm[ALARM_TYPES];                 // Occurrences
+uint64_t tlm_alarm_packets = 0;
+uint64_t tlm_other = 0;
+uint64_t tlm_bytes = 0;
+uint64_t tlm_digest = K_REPLAY_FNV_SEED;         // FNV-1a over every telemetry byte
+
+/**********************************************************************************************************************
+* Function      : void tallyTelemetry()
+* Description   : Counts the telemetry in the loopback TX capture, adds it to the digest, then clears it
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+void tallyTelemetry() {
+    const uint8_t *tx = instrument_port.txData();
+    size_t size = instrument_port.txSize();
+    size_t pos = 0;
+    while(pos + K_TLM_HEADER_SIZE <= size) {
+        const uint8_t *tlm = &tx[pos];
+        uint16_t apid = ((tlm[6] & 0x07) << 8) | tlm[7];
+        if(apid == K_ECHO_APID) {
+            tlm_echo++;
+        }else if(apid == K_ALARM_APID && tlm[18] >= 1 && tlm[18] <= ALARM_TYPES) {
+            tlm_alarm[tlm[18] - 1] += tlm[19];
+            tlm_alarm_packets++;
+        }else {
+            tlm_other++;
+        }
+        pos += (((tlm[4] & 0x1F) << 8) | tlm[5]) + K_INS_DATA_LEN_OFFSET;
+    }
+
+    for(size_t i = 0; i < size; i++) {
+        tlm_digest = (tlm_digest ^ tx[i]) * K_REPLAY_FNV_PRIME;
+    }
+    tlm_bytes += size;
+    instrument_port.clearTx();
+}
+
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        printf("usage: corpus_replay <file> [chunk bytes] [digest]\n");
+        return 1;
+    }
+    size_t chunk = K_REPLAY_DEFAULT_CHUNK;
+    if(argc > 2) {
+        chunk = strtoull(argv[2], NULL, 0);
+    }
+    bool pin_digest = argc > 3;
+    uint64_t expect_digest = pin_digest ? strtoull(argv[3], NULL, 16) : 0;
+    if(chunk == 0 || chunk > K_HOST_RX_SIZE) {
+        printf("FAIL: chunk must be 1 to %u bytes\n", K_HOST_RX_SIZE);
+        return 1;
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    if((size_t)st.st_size < sizeof(CorpusHeader)) {
+        printf("FAIL: %s is not a corpus\n", argv[1]);
+        return 1;
+    }
+    const uint8_t *file = (const uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(file == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    madvise((void *)file, st.st_size, MADV_SEQUENTIAL);
+
+    CorpusHeader header;
+    memcpy(&header, file, sizeof(header));
+    if(header.magic != K_CORPUS_MAGIC || header.version != K_CORPUS_VERSION ||
+       header.header_size + header.stream_bytes != (uint64_t)st.st_size) {
+        printf("FAIL: %s is not a version %u corpus\n", argv[1], K_CORPUS_VERSION);
+        return 1;
+    }
+    const uint8_t *stream = file + header.header_size;
+
+    auto start = std::chrono::steady_clock::now();
+    for(uint64_t pos = 0; pos < header.stream_bytes; pos += chunk) {
+        size_t len = header.stream_bytes - pos < chunk ? header.stream_bytes - pos : chunk;
+        instrument_port.feed(&stream[pos], len);
+        instrument.getData();
+        instrument.txDrain();
+        tallyTelemetry();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    munmap((void *)file, st.st_size);
+
+    uint64_t ccsds = tlm_alarm[CCSDS_FORMAT] + tlm_alarm[CCSDS_APID] + tlm_alarm[CCSDS_LENGTH];
+    printf("corpus      : %llu bytes, seed %llu, %llu byte chunks\n", (unsigned long long)header.stream_bytes,
+           (unsigned long long)header.seed, (unsigned long long)chunk);
+    printf("throughput  : %.2f s, %.0f MB/s, %.2f ns/byte, %.0fx 115200 baud (8O1)\n", seconds,
+           header.stream_bytes / seconds / 1e6, seconds * 1e9 / header.stream_bytes,
+           (header.stream_bytes / seconds) / (115200.0 / 11.0));
+    printf("echoes      : %llu of %llu expected\n", (unsigned long long)tlm_echo,
+           (unsigned long long)header.echoes);
+    printf("alarms      : %llu checksum of %llu, %llu length of %llu, %llu ccsds (at least %llu)\n",
+           (unsigned long long)tlm_alarm[ITF_CHECKSUM], (unsigned long long)header.checksum_alarms,
+           (unsigned long long)tlm_alarm[ITF_LENGTH], (unsigned long long)header.length_alarms,
+           (unsigned long long)ccsds, (unsigned long long)header.ccsds_alarms_min);
+    printf("alarm tlm   : %llu packets\n", (unsigned long long)tlm_alarm_packets);
+    printf("telemetry   : %llu bytes, %llu other, %u dropped, digest %016llx\n", (unsigned long long)tlm_bytes,
+           (unsigned long long)tlm_other, (unsigned)instrument.txQueueDropped(), (unsigned long long)tlm_digest);
+
+    if(tlm_echo != header.echoes || tlm_alarm[ITF_CHECKSUM] != header.checksum_alarms ||
+       tlm_alarm[ITF_LENGTH] != header.length_alarms || ccsds < header.ccsds_alarms_min || tlm_other != 0 ||
+       instrument.txQueueDropped() != 0 || (pin_digest && tlm_digest != expect_digest)) {
+        printf("FAIL\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/* crc_bench.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Checks every CRC engine against the byte-wise table, then compares their throughput on telemetry and
+ITF sized buffers. Usage: crc_bench [megabytes per run] */
+
+/********************
+Includes
+*********************/
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include "crc.h"
+
+/********************
+Constants
+*********************/
+const size_t K_BENCH_BUFF_SIZE = 65536;
+const size_t K_BENCH_SIZES[] = {22, 140, 512, 8196, 65536};
+
+/********************
+Structures
+*********************/
+typedef uint16_t (*CRC_ENGINE)(uint16_t checksum, const uint8_t *data, size_t len);
+
+typedef struct CrcEngine {
+    const char *name;
+    CRC_ENGINE run;
+} CrcEngine;
+
+/********************
+Global Variables
+*********************/
+const CrcEngine engines[] = {
+    {"bytewise", crcUpdateBytewise},
+    {"slice4", crcUpdateSlice4},
+    {"slice8", crcUpdateSlice8},
+    {"clmul", crcUpdateClmul},
+    {"crcUpdate", crcUpdate},
+};
+const size_t engine_count = sizeof(engines) / sizeof(engines[0]);
+
+uint8_t bench_buff[K_BENCH_BUFF_SIZE];
+
+/**********************************************************************************************************************
+* Function      : bool verifyEngines()
+* Description   : Compares every engine with the byte-wise table over random seeds, lengths and alignments
+* Arguments     : none
+* Returns       : bool - true if all engines agree
+**********************************************************************************************************************/
+bool verifyEngines() {
+    srand(1);
+    for(int trial = 0; trial < 20000; trial++) {
+        size_t offset = rand() % 16;
+        size_t len = rand() % 2048;
+        if(trial % 100 == 0) {
+            len = K_BENCH_BUFF_SIZE - offset;
+        }
+        uint16_t seed = (trial % 2) ? CRC_SEED : (uint16_t)rand();
+        uint16_t expect = crcUpdateBytewise(seed, &bench_buff[offset], len);
+        for(size_t e = 1; e < engine_count; e++) {
+            uint16_t got = engines[e].run(seed, &bench_buff[offset], len);
+            if(got != expect) {
+                printf("FAIL: %s seed %04X len %zu got %04X expected %04X\n", engines[e].name, seed, len, got, expect);
+                return false;
+            }
+        }
+    }
+
+    // Check value for CRC-16/CCITT-FALSE
+    if(crcUpdate(CRC_SEED, (const uint8_t *)"123456789", 9) != 0x29B1) {
+        printf("FAIL: check value\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t megabytes = 256;
+    if(argc > 1) {
+        megabytes = strtoull(argv[1], NULL, 0);
+    }
+
+    for(size_t i = 0; i < K_BENCH_BUFF_SIZE; i++) {
+        bench_buff[i] = (uint8_t)(rand() >> 7);
+    }
+    if(!verifyEngines()) {
+        return 1;
+    }
+    printf("all engines bit-exact, clmul %s\n", crcHasClmul() ? "available" : "not available (falls back to slice8)");
+
+    printf("%-10s", "size");
+    for(size_t e = 0; e < engine_count; e++) {
+        printf("%12s", engines[e].name);
+    }
+    printf("   (ns/byte)\n");
+
+    for(size_t size : K_BENCH_SIZES) {
+        size_t runs = megabytes * 1000000 / size;
+        printf("%-10zu", size);
+        for(size_t e = 0; e < engine_count; e++) {
+            // Chain the result into the seed so the calls can't be hoisted
+            uint16_t check = CRC_SEED;
+            auto start = std::chrono::steady_clock::now();
+            for(size_t r = 0; r < runs; r++) {
+                check = engines[e].run(check, bench_buff, size);
+            }
+            auto stop = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(stop - start).count();
+            printf("%12.3f", seconds * 1e9 / ((double)runs * size));
+            bench_buff[0] ^= check & 0x01;
+        }
+        printf("\n");
+    }
+    return 0;
+}
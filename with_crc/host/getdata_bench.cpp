@@ -0,0 +1,264 @@
+/* getdata_bench.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Host benchmark for the getData() receive FSM. Pushes generated uplink ITF frames through the loopback
+port and reports parser throughput. With batch set the echoes of each ITF come back in one TLM frame.
+With a capture file the run is recorded into a capture ring mapped over it, and the RX records left in the ring
+must be the last bytes fed. The virtual clock runs at the line rate as bytes are fed, so the records are
+stamped as they would be at the line. Usage: getdata_bench [frames] [batch] [capture file] */
+
+/********************
+Includes
+*********************/
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include "itf_frame.h"
+#include "tlm_decode.h"
+
+/********************
+Constants
+*********************/
+const uint32_t K_BENCH_VARIANTS = 64;            // Distinct frames cycled through
+const uint32_t K_BENCH_DEFAULT_FRAMES = 2000000;
+const uint32_t K_BENCH_CAPTURE_SIZE = 1 << 20;   // Small enough that a default run wraps it
+
+/********************
+Global Variables
+*********************/
+SerialPort instrument_port;                      // Loopback the bench drives
+InstrumentSim instrument(instrument_port);
+
+uint8_t bench_frames[K_BENCH_VARIANTS][K_MAX_PACKET_SIZE];
+size_t bench_sizes[K_BENCH_VARIANTS];
+uint8_t bench_cmds[K_BENCH_VARIANTS];
+
+// Telemetry seen on the loopback
+uint64_t tlm_status = 0;
+uint64_t tlm_echo = 0;
+uint64_t tlm_alarm = 0;
+uint64_t tlm_other = 0;
+uint64_t tlm_frames = 0;
+uint64_t tlm_bytes = 0;
+uint64_t tlm_bad_checks = 0;
+std::vector<uint8_t> tlm_wire;                   // Telemetry off the loopback not yet decoded
+bool echo_batch = false;
+
+uint64_t line_credit = 0;                        // Byte-microseconds fed but not yet on the clock
+
+/**********************************************************************************************************************
+* Function      : void buildFrames()
+* Description   : Generates frame variants with 1 to K_MAX_CMDS commands of varying argument counts
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+void buildFrames() {
+    uint8_t args[K_MAX_CMD_SIZE];
+    for(int i = 0; i < K_MAX_CMD_SIZE; i++) {
+        args[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    ItfCommand cmds[K_MAX_CMDS];
+    for(uint32_t v = 0; v < K_BENCH_VARIANTS; v++) {
+        uint8_t cmd_count = 1 + v % K_MAX_CMDS;
+        for(uint8_t c = 0; c < cmd_count; c++) {
+            // Opcodes without handlers, the bench times parsing and echoes
+            cmds[c].opcode = (uint8_t)(0x80 + v + c);
+            cmds[c].macro = c & 0x01;
+            cmds[c].arg_count = (uint8_t)((v * 3 + c * 5) % 16);
+            cmds[c].args = args;
+        }
+        // Drop commands until the frame fits
+        while(itfFrameSize(cmds, cmd_count, true) >= K_MAX_PACKET_SIZE) {
+            cmd_count--;
+        }
+        bench_cmds[v] = cmd_count;
+        bench_sizes[v] = buildItfFrame(bench_frames[v], v, cmds, cmd_count, true);
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : void feedLine(const uint8_t* data, size_t size)
+* Description   : Feeds bytes to the loopback and advances the virtual clock by the time they take on the line
+* Arguments     : const uint8_t* data, size_t size
+* Returns       : none
+**********************************************************************************************************************/
+void feedLine(const uint8_t *data, size_t size) {
+    uint32_t rate = instrument.linkLineRate();
+    line_credit += (uint64_t)size * 1000000;
+    uint32_t us = line_credit / rate;
+    line_credit -= (uint64_t)us * rate;
+    hostAdvanceMicros(us);
+    instrument_port.feed(data, size);
+}
+
+/**********************************************************************************************************************
+* Function      : bool checkCapture(const CaptureHeader* log, uint64_t bytes)
+* Description   : Checks the RX records in the ring are the stream fed, ending at its last byte
+* Arguments     : const CaptureHeader* log, uint64_t bytes - fed in total
+* Returns       : bool
+**********************************************************************************************************************/
+bool checkCapture(const CaptureHeader *log, uint64_t bytes) {
+    uint64_t cycle = 0;
+    uint64_t rx_bytes = 0;
+    uint64_t tx_records = 0;
+    const CaptureRecord *record;
+    const uint8_t *payload;
+    for(uint32_t v = 0; v < K_BENCH_VARIANTS; v++) {
+        cycle += bench_sizes[v];
+    }
+    CaptureCursor cursor = captureBegin(log);
+    while(captureNext(cursor, record, payload)) {
+        if(record->direction == CAPTURE_RX) {
+            rx_bytes += record->length;
+        }else {
+            tx_records++;
+        }
+    }
+    if(rx_bytes > bytes) {
+        return false;
+    }
+
+    // Walk the same records again alongside the stream from where the ring starts
+    uint64_t offset = (bytes - rx_bytes) % cycle;
+    uint32_t v = 0;
+    while(offset >= bench_sizes[v]) {
+        offset -= bench_sizes[v++];
+    }
+    cursor = captureBegin(log);
+    while(captureNext(cursor, record, payload)) {
+        for(uint16_t i = 0; record->direction == CAPTURE_RX && i < record->length; i++) {
+            if(payload[i] != bench_frames[v][offset]) {
+                return false;
+            }
+            if(++offset == bench_sizes[v]) {
+                offset = 0;
+                v = (v + 1) % K_BENCH_VARIANTS;
+            }
+        }
+    }
+    printf("capture     : %u records (%llu rx bytes, %llu tx frames), %u overwritten\n", log->count,
+           (unsigned long long)rx_bytes, (unsigned long long)tx_records, log->overwritten);
+    return true;
+}
+
+/**********************************************************************************************************************
+* Function      : void tallyTelemetry()
+* Description   : Decodes the telemetry in the loopback TX capture and counts it by kind, then clears the capture
+* Arguments     : none
+* Returns       : none
+* Remarks       : A frame cut off by the end of the capture is kept in tlm_wire for the next call
+**********************************************************************************************************************/
+void tallyTelemetry() {
+    tlm_bytes += instrument_port.txSize();
+    tlm_wire.insert(tlm_wire.end(), instrument_port.txData(), instrument_port.txData() + instrument_port.txSize());
+    instrument_port.clearTx();
+
+    TlmCursor cursor = tlmDecodeBegin(tlm_wire.data(), tlm_wire.size(), false);
+    TlmFrame frame;
+    TlmEcho echo;
+    while(tlmDecodeNext<INSTRUMENT_CHECKSUM>(cursor, frame)) {
+        uint16_t offset = 0;
+        switch(frame.kind) {
+            case TLM_STATUS: tlm_status++; break;
+            case TLM_ECHO:
+                while(tlmDecodeEcho(frame, offset, echo)) {
+                    tlm_echo++;
+                }
+                break;
+            case TLM_ALARM: tlm_alarm++; break;
+            default: tlm_other++; break;
+        }
+    }
+    tlm_frames += cursor.frames;
+    tlm_bad_checks += cursor.bad_checks;
+    tlm_wire.erase(tlm_wire.begin(), tlm_wire.begin() + cursor.offset);
+}
+
+int main(int argc, char **argv) {
+    uint64_t frames = K_BENCH_DEFAULT_FRAMES;
+    if(argc > 1) {
+        frames = strtoull(argv[1], NULL, 0);
+    }
+
+    if(argc > 2) {
+        echo_batch = strtoul(argv[2], NULL, 0) != 0;
+    }
+
+    CaptureHeader *capture = NULL;
+    if(argc > 3) {
+        capture = captureMapFile(argv[3], K_BENCH_CAPTURE_SIZE);
+        if(capture == NULL) {
+            printf("FAIL: can't map %s\n", argv[3]);
+            return 1;
+        }
+    }
+
+    buildFrames();
+
+    if(echo_batch) {
+        uint8_t mode = 1;
+        ItfCommand batch_cmd = {K_INS_CMD_ECHO_MODE, 0, K_CMD_ECHO_MODE_ARGS, &mode};
+        uint8_t frame[K_MAX_PACKET_SIZE];
+        instrument_port.feed(frame, buildItfFrame(frame, 0, &batch_cmd, 1, true));
+        instrument.getData();
+        instrument.txDrain();
+        instrument_port.clearTx();
+    }
+    if(capture != NULL) {
+        instrument.captureAttach(capture, 0);
+    }
+
+    uint64_t bytes = 0;
+    uint64_t commands = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(uint64_t i = 0; i < frames; i++) {
+        uint32_t v = i % K_BENCH_VARIANTS;
+        // Every other frame arrives split across two getData() calls
+        size_t split = (i & 1) ? bench_sizes[v] / 2 : bench_sizes[v];
+        feedLine(bench_frames[v], split);
+        instrument.getData();
+        instrument.txDrain();
+        feedLine(&bench_frames[v][split], bench_sizes[v] - split);
+        instrument.getData();
+        instrument.txDrain();
+        tallyTelemetry();
+        bytes += bench_sizes[v];
+        commands += bench_cmds[v];
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(stop - start).count();
+
+    printf("frames      : %llu (%llu bytes, %llu commands)\n",
+           (unsigned long long)frames, (unsigned long long)bytes, (unsigned long long)commands);
+    printf("frames/s    : %.0f\n", frames / seconds);
+    printf("bytes/s     : %.0f\n", bytes / seconds);
+    printf("ns/byte     : %.2f\n", seconds * 1e9 / bytes);
+    printf("115200 baud : %.0fx line rate (8O1)\n", (bytes / seconds) / (115200.0 / 11.0));
+    printf("telemetry   : %llu status, %llu echo, %llu alarm, %llu other, %llu bad checks\n",
+           (unsigned long long)tlm_status, (unsigned long long)tlm_echo,
+           (unsigned long long)tlm_alarm, (unsigned long long)tlm_other, (unsigned long long)tlm_bad_checks);
+    printf("tlm frames  : %llu, %.1f bytes per command (%s echoes)\n", (unsigned long long)tlm_frames,
+           (double)tlm_bytes / commands, echo_batch ? "batched" : "single");
+    printf("tx queue    : high water %u of %u slots, %u dropped\n",
+           instrument.txQueueHighWater(), K_TX_SLOTS, (unsigned)instrument.txQueueDropped());
+
+    // Generated frames are all valid, anything else means the parser and generator disagree
+    if(tlm_echo != commands || tlm_alarm != 0) {
+        printf("FAIL: expected %llu echoes and no alarms\n", (unsigned long long)commands);
+        return 1;
+    }
+    if(tlm_bad_checks != 0) {
+        printf("FAIL: %llu telemetry frames failed the checksum\n", (unsigned long long)tlm_bad_checks);
+        return 1;
+    }
+    if(capture != NULL && !checkCapture(capture, bytes)) {
+        printf("FAIL: RX records in the capture don't match the stream fed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+/* itf_corpus.h
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Uplink corpus file shared by corpus_gen and corpus_replay. A CorpusHeader in host byte order, then the raw
+byte stream exactly as it would arrive on the UART. The header carries what the generator built and the
+telemetry getData() must answer it with. */
+
+#ifndef ITF_CORPUS_H
+#define ITF_CORPUS_H
+
+/********************
+Includes
+*********************/
+#include "itf_frame.h"
+
+/********************
+Constants
+*********************/
+const uint32_t K_CORPUS_MAGIC = 0x43465449;      // "ITFC"
+const uint16_t K_CORPUS_VERSION = 1;
+
+/********************
+Structures
+*********************/
+typedef enum CORPUS_KIND {
+    CORPUS_VALID = 0,                            // Good frame, every command echoed
+    CORPUS_BAD_CRC = 1,                          // Bit error in the last command or CRC, one ITF_CHECKSUM
+    CORPUS_BAD_LENGTH = 2,                       // Frame length out of range, one ITF_LENGTH
+    CORPUS_BAD_APID = 3,                         // 0x1900 or 0x1B00 header variant with a good CRC
+    CORPUS_TRUNCATED = 4,                        // Line drops out mid frame, idle fill up to its length
+    CORPUS_PADDING = 5,                          // Idle fill between frames
+    CORPUS_KINDS = 6,
+} CORPUS_KIND;
+
+typedef struct CorpusHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;                        // Stream starts here
+    uint64_t seed;
+    uint64_t stream_bytes;
+    uint64_t records[CORPUS_KINDS];              // Records of each CORPUS_KIND
+
+    // Expected telemetry
+    uint64_t echoes;
+    uint64_t checksum_alarms;
+    uint64_t length_alarms;
+    uint64_t ccsds_alarms_min;                   // CCSDS format, APID and length together, at least one per bad APID
+} CorpusHeader;
+
+#endif
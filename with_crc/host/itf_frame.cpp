@@ -0,0 +1,97 @@
+/* itf_frame.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Builds uplink ITF frames byte-for-byte as the getData() FSM parses them:
+    0-3     sync
+    4-5     frame length - 6
+    6-7     spare
+    8-47    spacecraft time packet (0x1900, length 33, time at 14-17, reserved zero)
+    ...     command packets (0x1B00, length at +6, opcode at +12, macro at +13, args from +14)
+    last 2  CRC-CCITT over bytes 4 onward */
+
+/********************
+Includes
+*********************/
+#include "itf_frame.h"
+
+/**********************************************************************************************************************
+* Function      : size_t itfFrameSize(const ItfCommand* cmds, uint8_t cmd_count, bool with_time)
+* Description   : Total size of the frame buildItfFrame() would produce
+* Arguments     : const ItfCommand* cmds, uint8_t cmd_count, bool with_time
+* Returns       : size_t
+**********************************************************************************************************************/
+size_t itfFrameSize(const ItfCommand *cmds, uint8_t cmd_count, bool with_time) {
+    size_t size = with_time ? K_ITF_TIME_END : K_ITF_PACKET_START;
+    for(uint8_t i = 0; i < cmd_count; i++) {
+        size += cmds[i].arg_count + K_ITF_CMD_OVERHEAD;
+    }
+    // Frame CRC
+    return size + 2;
+}
+
+/**********************************************************************************************************************
+* Function      : size_t buildItfFrame(uint8_t* out, uint32_t time, const ItfCommand* cmds, uint8_t cmd_count, bool with_time)
+* Description   : Writes a complete uplink frame into out
+* Arguments     : uint8_t* out - at least itfFrameSize() bytes
+*                 uint32_t time - spacecraft time for the time packet
+*                 const ItfCommand* cmds, uint8_t cmd_count - commands to carry
+*                 bool with_time - include the spacecraft time packet
+* Returns       : size_t - bytes written
+**********************************************************************************************************************/
+size_t buildItfFrame(uint8_t *out, uint32_t time, const ItfCommand *cmds, uint8_t cmd_count, bool with_time) {
+    size_t size = itfFrameSize(cmds, cmd_count, with_time);
+    memset(out, 0x00, size);
+
+    // Sync
+    out[0] = (SYNC >> 24) & 0xFF;
+    out[1] = (SYNC >> 16) & 0xFF;
+    out[2] = (SYNC >> 8) & 0xFF;
+    out[3] = SYNC & 0xFF;
+    // Length after this field
+    out[4] = ((size - K_INS_DATA_LEN_OFFSET) >> 8) & 0x1F;
+    out[5] = (size - K_INS_DATA_LEN_OFFSET) & 0xFF;
+
+    size_t pos = K_ITF_PACKET_START;
+    if(with_time) {
+        // Time packet header
+        out[8] = 0x19;
+        out[9] = 0x00;
+        out[12] = 0x00;
+        out[13] = K_TIME_SIZE;
+        // Time
+        out[14] = (time >> 24) & 0xFF;
+        out[15] = (time >> 16) & 0xFF;
+        out[16] = (time >> 8) & 0xFF;
+        out[17] = time & 0xFF;
+        pos = K_ITF_TIME_END;
+    }
+
+    for(uint8_t i = 0; i < cmd_count; i++) {
+        const ItfCommand &cmd = cmds[i];
+        uint16_t cmd_len = cmd.arg_count + 3;
+        // Command header
+        out[pos] = 0x1B;
+        out[pos + 1] = 0x00;
+        out[pos + 6] = (cmd_len >> 8) & 0xFF;
+        out[pos + 7] = cmd_len & 0xFF;
+        // Opcode, Macro, Arguments
+        out[pos + 12] = cmd.opcode;
+        out[pos + 13] = cmd.macro;
+        for(uint8_t j = 0; j < cmd.arg_count; j++) {
+            out[pos + 14 + j] = cmd.args[j];
+        }
+        // Trailer, kept non-zero so it is never taken for padding
+        memset(&out[pos + 14 + cmd.arg_count], 0xA5, K_ITF_CMD_OVERHEAD - 14);
+        pos += cmd.arg_count + K_ITF_CMD_OVERHEAD;
+    }
+
+    // Checksum at end
+    uint16_t check = crcUpdate(CRC_SEED, &out[4], size - 6);
+    out[size - 2] = (check >> 8) & 0xFF;
+    out[size - 1] = check & 0xFF;
+
+    return size;
+}
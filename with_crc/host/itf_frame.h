@@ -0,0 +1,40 @@
+/* itf_frame.h
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Host-side builder for uplink ITF frames in the layout getData() expects, used by the benchmarks */
+
+#ifndef ITF_FRAME_H
+#define ITF_FRAME_H
+
+/********************
+Includes
+*********************/
+#include "instrument_driver.h"
+
+/********************
+Constants
+*********************/
+const uint8_t K_ITF_PACKET_START = 8;            // First packet after sync, length and spare
+const uint8_t K_ITF_CMD_OVERHEAD = 23;           // Command bytes that are not arguments
+const uint8_t K_ITF_TIME_END = 48;               // First byte after the spacecraft time packet
+
+/********************
+Structures
+*********************/
+typedef struct ItfCommand {
+    uint8_t opcode;
+    uint8_t macro;
+    uint8_t arg_count;
+    const uint8_t *args;
+} ItfCommand;
+
+/********************
+Functions
+*********************/
+size_t itfFrameSize(const ItfCommand *cmds, uint8_t cmd_count, bool with_time);
+size_t buildItfFrame(uint8_t *out, uint32_t time, const ItfCommand *cmds, uint8_t cmd_count, bool with_time);
+
+#endif
@@ -0,0 +1,133 @@
+/* line_harness.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+OBC side of the line shared by the benches that run at line rate, see line_harness.h */
+
+/********************
+Includes
+*********************/
+#include "line_harness.h"
+
+/**********************************************************************************************************************
+* Function      : void lineBegin(LineHarness& line, SerialPort& port, InstrumentSim& instrument, on_frame)
+* Description   : Sizes the loopback like the Teensy UART and clears the harness
+* Arguments     : LineHarness& line, SerialPort& port, InstrumentSim& instrument,
+*                 void (*on_frame)(const TlmFrame&) - called for each frame off the line, may be NULL
+* Returns       : none
+* Remarks       : The link rate is left to the bench, linkBegin() before the first step
+**********************************************************************************************************************/
+void lineBegin(LineHarness &line, SerialPort &port, InstrumentSim &instrument, void (*on_frame)(const TlmFrame &)) {
+    line.port = &port;
+    line.instrument = &instrument;
+    line.on_frame = on_frame;
+    line.uplink.clear();
+    line.uplink_pos = 0;
+    line.uplink_credit = 0;
+    line.load = false;
+    line.load_bytes.clear();
+    line.load_cycles = 0;
+    line.frame_time = 0;
+    line.wire.clear();
+    line.frames = 0;
+    line.bad_checks = 0;
+
+    port.setRxBuffer(K_LINE_UART_RX);
+    port.setLine(K_LINE_UART_TX);
+}
+
+/**********************************************************************************************************************
+* Function      : void lineQueueFrame(LineHarness& line, const ItfCommand* cmds, uint8_t cmd_count)
+* Description   : Adds an ITF frame to the uplink
+* Arguments     : LineHarness& line, const ItfCommand* cmds, uint8_t cmd_count
+* Returns       : none
+**********************************************************************************************************************/
+void lineQueueFrame(LineHarness &line, const ItfCommand *cmds, uint8_t cmd_count) {
+    uint8_t frame[K_MAX_PACKET_SIZE];
+    size_t size = buildItfFrame(frame, line.frame_time++, cmds, cmd_count, true);
+    line.uplink.insert(line.uplink.end(), frame, frame + size);
+}
+
+/**********************************************************************************************************************
+* Function      : void lineDecode(LineHarness& line)
+* Description   : Moves the TX capture onto the wire buffer and hands each complete frame in it to on_frame
+* Arguments     : LineHarness& line
+* Returns       : none
+**********************************************************************************************************************/
+static void lineDecode(LineHarness &line) {
+    line.wire.insert(line.wire.end(), line.port->txData(), line.port->txData() + line.port->txSize());
+    line.port->clearTx();
+
+    TlmCursor cursor = tlmDecodeBegin(line.wire.data(), line.wire.size(), false);
+    TlmFrame frame;
+    while(tlmDecodeNext<INSTRUMENT_CHECKSUM>(cursor, frame)) {
+        if(line.on_frame != NULL) {
+            line.on_frame(frame);
+        }
+    }
+    line.frames += cursor.frames;
+    line.bad_checks += cursor.bad_checks;
+    line.wire.erase(line.wire.begin(), line.wire.begin() + cursor.offset);
+}
+
+/**********************************************************************************************************************
+* Function      : void lineStep(LineHarness& line)
+* Description   : One pass of loop(), with the uplink fed at the line rate
+* Arguments     : LineHarness& line
+* Returns       : none
+**********************************************************************************************************************/
+void lineStep(LineHarness &line) {
+    hostAdvanceMicros(K_LINE_LOOP_US);
+
+    // OBC side of the line
+    line.uplink_credit += (uint64_t)K_LINE_LOOP_US * line.instrument->linkLineRate();
+    size_t line_bytes = line.uplink_credit / 1000000;
+    line.uplink_credit -= line_bytes * 1000000;
+    while(line_bytes > 0) {
+        if(line.uplink_pos == line.uplink.size()) {
+            line.uplink.clear();
+            line.uplink_pos = 0;
+            if(!line.load || line.load_bytes.empty()) {
+                line.uplink_credit = 0;
+                break;
+            }
+            line.uplink.insert(line.uplink.end(), line.load_bytes.begin(), line.load_bytes.end());
+            line.load_cycles++;
+        }
+        size_t chunk = line.uplink.size() - line.uplink_pos;
+        if(chunk > line_bytes) {
+            chunk = line_bytes;
+        }
+        line.port->feed(&line.uplink[line.uplink_pos], chunk);
+        line.uplink_pos += chunk;
+        line_bytes -= chunk;
+    }
+
+    line.instrument->service();
+    lineDecode(line);
+}
+
+/**********************************************************************************************************************
+* Function      : void lineRunFor(LineHarness& line, uint32_t us)
+* Description   : Steps for us of virtual time
+* Arguments     : LineHarness& line, uint32_t us
+* Returns       : none
+**********************************************************************************************************************/
+void lineRunFor(LineHarness &line, uint32_t us) {
+    uint32_t start_us = micros();
+    while(micros() - start_us < us) {
+        lineStep(line);
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : bool lineIdle(LineHarness& line)
+* Description   : Nothing left to send either way
+* Arguments     : LineHarness& line
+* Returns       : bool
+**********************************************************************************************************************/
+bool lineIdle(LineHarness &line) {
+    return line.uplink_pos == line.uplink.size() && line.instrument->txQueueDepth() == 0;
+}
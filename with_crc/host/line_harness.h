@@ -0,0 +1,76 @@
+/* line_harness.h
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+OBC side of the line for benches that run the driver on the virtual clock. lineStep() is one loop() pass:
+it advances the clock, feeds the uplink at the rate the link is set to, runs service() and decodes the
+telemetry off the line with tlmDecodeNext(), handing each frame to the bench. With load set the uplink is
+refilled with the load bytes whenever it runs dry, so the line is never idle.
+NOTES: a frame that fails the checksum is counted in bad_checks and skipped, benches should fail on it */
+
+#ifndef LINE_HARNESS_H
+#define LINE_HARNESS_H
+
+/********************
+Includes
+*********************/
+#include <vector>
+#include "itf_frame.h"
+#include "tlm_decode.h"
+
+/********************
+Constants
+*********************/
+const uint32_t K_LINE_UART_RX = 64 + 4096;       // Teensy 4 Serial2 RX buffer and the memory added to it
+const uint32_t K_LINE_UART_TX = 40 + 1024 + 4;   // TX buffer, added memory and hardware FIFO
+const uint32_t K_LINE_LOOP_US = 20;              // Virtual time per loop() pass
+
+/********************
+Structures
+*********************/
+typedef struct LineHarness {
+    SerialPort *port;
+    InstrumentSim *instrument;
+    void (*on_frame)(const TlmFrame &frame);       // Each telemetry frame that passes the checksum
+    std::vector<uint8_t> uplink;                   // Bytes the OBC still has to send
+    size_t uplink_pos;
+    uint64_t uplink_credit;                        // Byte-microseconds of line time not yet used
+    bool load;                                     // Keep the uplink full of load_bytes
+    std::vector<uint8_t> load_bytes;
+    uint64_t load_cycles;                          // Times load_bytes was queued
+    uint32_t frame_time;                           // Time of the next queued ITF
+    std::vector<uint8_t> wire;                     // Bytes off the line not yet decoded
+    uint64_t frames;
+    uint64_t bad_checks;
+} LineHarness;
+
+/********************
+Functions
+*********************/
+void lineBegin(LineHarness &line, SerialPort &port, InstrumentSim &instrument, void (*on_frame)(const TlmFrame &));
+void lineQueueFrame(LineHarness &line, const ItfCommand *cmds, uint8_t cmd_count);
+void lineStep(LineHarness &line);
+void lineRunFor(LineHarness &line, uint32_t us);
+bool lineIdle(LineHarness &line);
+
+/**********************************************************************************************************************
+* Function      : template<class Done> bool lineRunUntil(LineHarness& line, Done done, uint32_t timeout_us)
+* Description   : Steps until done() or timeout_us of virtual time
+* Arguments     : LineHarness& line, Done done, uint32_t timeout_us
+* Returns       : bool - false on timeout
+**********************************************************************************************************************/
+template <class Done>
+bool lineRunUntil(LineHarness &line, Done done, uint32_t timeout_us) {
+    uint32_t start_us = micros();
+    while(!done()) {
+        if(micros() - start_us > timeout_us) {
+            return false;
+        }
+        lineStep(line);
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,175 @@
+/* link_bench.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Link self-test sweep on the virtual clock. For each baud rate the bench commands the change (K_INS_CMD_LINK),
+starts a self-test (K_INS_CMD_LINK_TEST) and loads the uplink back to back with full command frames, paced
+at the line rate into a UART sized RX buffer. The self-test packet on APID 0x303 is decoded into the report,
+with the command turnaround from the latency histograms alongside. With dump set the full histograms are
+printed for each rate. Usage: link_bench [test ms] [dump] */
+
+/********************
+Includes
+*********************/
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include "line_harness.h"
+
+/********************
+Constants
+*********************/
+const uint32_t K_BENCH_RATES[] = {115200, 460800, 921600, 2000000, 4000000, 6000000};
+const uint16_t K_BENCH_DEFAULT_TEST_MS = 2000;
+const uint8_t K_BENCH_LOAD_ARGS = 20;             // Arguments per load command
+const uint32_t K_BENCH_TIMEOUT_US = 10000000;
+
+/********************
+Structures
+*********************/
+typedef struct LinkResult {
+    uint32_t baud;
+    uint8_t format;
+    uint32_t window_ms;
+    uint32_t rx_frames;
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    uint32_t rx_frames_per_s;
+    uint32_t tx_bytes_per_s;
+    uint32_t overruns;
+    uint32_t crc_failures;
+    uint32_t tx_dropped;
+} LinkResult;
+
+/********************
+Global Variables
+*********************/
+SerialPort instrument_port;                      // Loopback the bench drives
+InstrumentSim instrument(instrument_port);
+LineHarness line;
+
+bool report_seen = false;
+LinkResult report;
+
+/**********************************************************************************************************************
+* Function      : uint32_t get32(const uint8_t* field)
+* Description   : Reads a big endian 32 bit TLM field
+* Arguments     : const uint8_t* field
+* Returns       : uint32_t
+**********************************************************************************************************************/
+uint32_t get32(const uint8_t *field) {
+    return ((uint32_t)field[0] << 24) | ((uint32_t)field[1] << 16) | (field[2] << 8) | field[3];
+}
+
+/**********************************************************************************************************************
+* Function      : void onFrame(const TlmFrame& frame)
+* Description   : Decodes a link report off the line
+* Arguments     : const TlmFrame& frame
+* Returns       : none
+**********************************************************************************************************************/
+void onFrame(const TlmFrame &frame) {
+    if(frame.kind != TLM_LINK) {
+        return;
+    }
+    const uint8_t *tlm = frame.data;
+    report.baud = get32(&tlm[16]);
+    report.format = tlm[20];
+    report.window_ms = get32(&tlm[22]);
+    report.rx_frames = get32(&tlm[26]);
+    report.rx_bytes = get32(&tlm[30]);
+    report.tx_bytes = get32(&tlm[34]);
+    report.rx_frames_per_s = get32(&tlm[38]);
+    report.tx_bytes_per_s = get32(&tlm[42]);
+    report.overruns = get32(&tlm[46]);
+    report.crc_failures = get32(&tlm[50]);
+    report.tx_dropped = get32(&tlm[54]);
+    report_seen = true;
+}
+
+int main(int argc, char **argv) {
+    uint16_t test_ms = K_BENCH_DEFAULT_TEST_MS;
+    bool dump = false;
+    if(argc > 1) {
+        test_ms = strtoul(argv[1], NULL, 0);
+    }
+    if(argc > 2) {
+        dump = strtoul(argv[2], NULL, 0) != 0;
+    }
+
+    lineBegin(line, instrument_port, instrument, onFrame);
+    instrument.linkBegin(K_BENCH_RATES[0], LINK_8O1);
+
+    // Full frame of commands with handlers that only echo
+    uint8_t load_args[K_BENCH_LOAD_ARGS] = {0};
+    ItfCommand load_cmds[K_MAX_CMDS];
+    for(uint8_t c = 0; c < K_MAX_CMDS; c++) {
+        load_cmds[c] = {(uint8_t)(0x80 + c), 0, K_BENCH_LOAD_ARGS, load_args};
+    }
+    uint8_t load_frame[K_MAX_PACKET_SIZE];
+    size_t load_size = buildItfFrame(load_frame, 0, load_cmds, K_MAX_CMDS, true);
+    line.load_bytes.assign(load_frame, load_frame + load_size);
+
+    printf("load: %zu byte frames of %u commands, 8O1, %u ms per rate\n", load_size, K_MAX_CMDS, test_ms);
+    printf("%9s %10s %10s %10s %8s %9s %5s %8s %6s %10s %10s\n", "baud", "rx fr/s", "line fr/s", "tx B/s", "tx use",
+           "overruns", "crc", "dropped", "cpu", "turn mean", "turn max");
+
+    bool pass = true;
+    for(uint32_t baud : K_BENCH_RATES) {
+        // Command the rate at the current one, the OBC follows once it has switched
+        if(baud != instrument.linkBaud()) {
+            uint8_t link_args[K_CMD_LINK_ARGS] = {(uint8_t)(baud >> 24), (uint8_t)(baud >> 16), (uint8_t)(baud >> 8),
+                                                  (uint8_t)baud, LINK_8O1};
+            ItfCommand link_cmd = {K_INS_CMD_LINK, 0, K_CMD_LINK_ARGS, link_args};
+            lineQueueFrame(line, &link_cmd, 1);
+            if(!lineRunUntil(line, [&] { return instrument.linkBaud() == baud; }, K_BENCH_TIMEOUT_US)) {
+                printf("FAIL: link change to %u\n", baud);
+                return 1;
+            }
+        }
+
+        // Self-test under full load
+        uint8_t test_args[K_CMD_LINK_TEST_ARGS] = {(uint8_t)(test_ms >> 8), (uint8_t)test_ms};
+        ItfCommand test_cmd = {K_INS_CMD_LINK_TEST, 0, K_CMD_LINK_TEST_ARGS, test_args};
+        lineQueueFrame(line, &test_cmd, 1);
+        instrument.latencyReset();
+        line.load = true;
+        report_seen = false;
+        auto start = std::chrono::steady_clock::now();
+        uint32_t start_us = micros();
+        bool done = lineRunUntil(line, [] { return report_seen; }, K_BENCH_TIMEOUT_US);
+        double cpu = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() /
+                     ((micros() - start_us) * 1e-6);
+        line.load = false;
+        if(!done) {
+            printf("FAIL: no link report at %u\n", baud);
+            return 1;
+        }
+
+        // Let the line go quiet before the next change
+        lineRunUntil(line, [] { return lineIdle(line); }, K_BENCH_TIMEOUT_US);
+
+        uint32_t line_frames = instrument.linkLineRate() / load_size;
+        const LAT_HIST &turn = instrument.latencyHist(LAT_TURNAROUND);
+        printf("%9u %10u %10u %10u %7.1f%% %9u %5u %8u %5.1f%% %8.0fus %8uus\n", report.baud,
+               report.rx_frames_per_s, line_frames, report.tx_bytes_per_s,
+               100.0f * report.tx_bytes_per_s / instrument.linkLineRate(), report.overruns, report.crc_failures,
+               report.tx_dropped, 100.0 * cpu, turn.count ? (double)turn.sum_us / turn.count : 0.0, turn.max_us);
+        if(dump) {
+            instrument.latencyDump();
+        }
+
+        // Every frame the line can carry must be parsed and answered
+        if(report.baud != baud || report.overruns || report.crc_failures || report.tx_dropped ||
+           report.rx_frames_per_s + 1 < line_frames || line.bad_checks != 0) {
+            pass = false;
+        }
+    }
+
+    if(!pass) {
+        printf("FAIL\n");
+        return 1;
+    }
+    return 0;
+}
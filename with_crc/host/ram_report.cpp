@@ -0,0 +1,31 @@
+/* ram_report.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Prints the capacity the driver was built with and the RAM each instrument takes. Build with the same
+-DINSTRUMENT_MAX_PACKET=, -DINSTRUMENT_MAX_CMDS= and -DINSTRUMENT_MAX_CMD_SIZE= as the sketch.
+Usage: ram_report [instruments] */
+
+/********************
+Includes
+*********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "instrument_driver.h"
+
+int main(int argc, char **argv) {
+    uint32_t instruments = argc > 1 ? strtoul(argv[1], NULL, 0) : 1;
+
+    RAM_REPORT ram = InstrumentSim::ramReport();
+    printf("capacity    : %u byte ITF, %u commands of up to %u bytes, %u TX slots of %u bytes\n", K_MAX_PACKET_SIZE,
+           K_MAX_CMDS, K_MAX_CMD_SIZE, K_TX_SLOTS, K_TX_SLOT_SIZE);
+    printf("rx          : %7u bytes, %u ITF buffers\n", ram.rx, K_RX_BUFFS);
+    printf("tx          : %7u bytes\n", ram.tx);
+    printf("science     : %7u bytes, %u frames\n", ram.science, K_SCIENCE_BUFFS);
+    printf("other       : %7u bytes\n", ram.other);
+    printf("port        : %7u bytes, UART memory in SerialPort\n", ram.port);
+    printf("total       : %7u bytes per instrument, %u for %u\n", ram.total, ram.total * instruments, instruments);
+    return 0;
+}
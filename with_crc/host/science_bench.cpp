@@ -0,0 +1,174 @@
+/* science_bench.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Streams survey science telemetry through a UART paced on the virtual clock, with a time and command ITF
+every second for housekeeping to interleave with. Checks every frame on the wire (CRC, science sequence
+count and payload ramp) and reports achieved against theoretical line rate.
+Usage: science_bench [baud] [frame size] [seconds] */
+
+/********************
+Includes
+*********************/
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "itf_frame.h"
+
+/********************
+Constants
+*********************/
+const uint32_t K_BENCH_DEFAULT_BAUD = 115200;
+const uint32_t K_BENCH_DEFAULT_SECONDS = 30;
+const uint32_t K_BENCH_UART_FIFO = 44;           // Teensy 4 Serial2 TX buffer and hardware FIFO
+const uint32_t K_BENCH_LOOP_US = 20;             // Virtual time per loop() pass
+const uint8_t K_BENCH_ECHO_CMDS = 3;             // Commands in each once a second ITF
+
+/********************
+Global Variables
+*********************/
+SerialPort instrument_port;                      // Loopback the bench drives
+InstrumentSim instrument(instrument_port);
+
+std::vector<uint8_t> wire;                       // Bytes off the line not yet checked
+
+// Frames seen on the line
+uint64_t sci_frames = 0;
+uint64_t sci_bytes = 0;
+uint64_t hk_frames = 0;
+uint64_t crc_errors = 0;
+uint64_t seq_gaps = 0;
+uint64_t ramp_errors = 0;
+int32_t last_sci_seq = -1;
+
+/**********************************************************************************************************************
+* Function      : void checkWire()
+* Description   : Moves the TX capture onto the wire buffer and checks every complete frame in it
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+void checkWire() {
+    wire.insert(wire.end(), instrument_port.txData(), instrument_port.txData() + instrument_port.txSize());
+    instrument_port.clearTx();
+
+    size_t pos = 0;
+    while(pos + K_TLM_HEADER_SIZE <= wire.size()) {
+        const uint8_t *tlm = &wire[pos];
+        size_t pack_size = (((tlm[4] & 0x1F) << 8) | tlm[5]) + K_INS_DATA_LEN_OFFSET;
+        if(pos + pack_size > wire.size()) {
+            break;
+        }
+
+        uint16_t check = crcUpdate(CRC_SEED, &tlm[K_TLM_CRC_OFFSET], pack_size - K_TLM_CRC_OFFSET - 2);
+        uint16_t apid = ((tlm[6] & 0x07) << 8) | tlm[7];
+        if(apid == K_SCIENCE_APID) {
+            if(check != ((tlm[pack_size - 2] << 8) | tlm[pack_size - 1])) {
+                crc_errors++;
+            }
+            int32_t seq = ((tlm[8] & 0x3F) << 8) | tlm[9];
+            if(last_sci_seq >= 0 && seq != ((last_sci_seq + 1) & 0x3FFF)) {
+                seq_gaps++;
+            }
+            last_sci_seq = seq;
+            for(size_t i = K_SCIENCE_HEADER_SIZE; i < pack_size - 2; i++) {
+                if(tlm[i] != (uint8_t)(tlm[19] + i)) {
+                    ramp_errors++;
+                    break;
+                }
+            }
+            sci_frames++;
+            sci_bytes += pack_size;
+        }else {
+            hk_frames++;
+        }
+        pos += pack_size;
+    }
+    wire.erase(wire.begin(), wire.begin() + pos);
+}
+
+/**********************************************************************************************************************
+* Function      : void uplink(uint32_t time, const ItfCommand* cmds, uint8_t cmd_count)
+* Description   : Feeds a time packet and commands to the driver
+* Arguments     : uint32_t time, const ItfCommand* cmds, uint8_t cmd_count
+* Returns       : none
+**********************************************************************************************************************/
+void uplink(uint32_t time, const ItfCommand *cmds, uint8_t cmd_count) {
+    uint8_t frame[K_MAX_PACKET_SIZE];
+    size_t size = buildItfFrame(frame, time, cmds, cmd_count, true);
+    instrument_port.feed(frame, size);
+}
+
+int main(int argc, char **argv) {
+    uint32_t baud = K_BENCH_DEFAULT_BAUD;
+    uint16_t frame_size = K_MAX_TLM_SIZE;
+    uint32_t seconds = K_BENCH_DEFAULT_SECONDS;
+    if(argc > 1) {
+        baud = strtoul(argv[1], NULL, 0);
+    }
+    if(argc > 2) {
+        frame_size = strtoul(argv[2], NULL, 0);
+    }
+    if(argc > 3) {
+        seconds = strtoul(argv[3], NULL, 0);
+    }
+
+    instrument_port.setLine(K_BENCH_UART_FIFO);
+    instrument.linkBegin(baud, LINK_8O1);
+
+    // Turn survey on
+    uint8_t surv_args[K_CMD_MODE_ARGS] = {1, (uint8_t)(frame_size >> 8), (uint8_t)frame_size};
+    ItfCommand surv = {K_INS_CMD_SURVEY, 0, K_CMD_MODE_ARGS, surv_args};
+    uplink(0, &surv, 1);
+
+    uint8_t echo_args[K_ECHO_MAX_ARGS] = {0};
+    ItfCommand echoes[K_BENCH_ECHO_CMDS];
+    for(uint8_t c = 0; c < K_BENCH_ECHO_CMDS; c++) {
+        echoes[c] = {(uint8_t)(0x80 + c), 0, (uint8_t)(c * 3), echo_args};
+    }
+
+    uint32_t start_us = micros();
+    uint64_t start_line = instrument_port.lineSent();
+    uint32_t start_tx = instrument.txBytesWritten();
+    double drain_seconds = 0;
+    uint32_t second = 0;
+    while(micros() - start_us < seconds * 1000000) {
+        hostAdvanceMicros(K_BENCH_LOOP_US);
+        if((micros() - start_us) / 1000000 != second) {
+            second++;
+            uplink(second, echoes, K_BENCH_ECHO_CMDS);
+        }
+
+        instrument.loopTimer();
+        instrument.getData();
+        instrument.statusService();
+        auto drain_start = std::chrono::steady_clock::now();
+        instrument.txDrain();
+        drain_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - drain_start).count();
+        checkWire();
+    }
+    uint32_t elapsed_us = micros() - start_us;
+    uint32_t line_bytes = instrument_port.lineSent() - start_line;
+
+    printf("line        : %u baud 8O1, %u B/s theoretical\n", baud, instrument.linkLineRate());
+    printf("achieved    : %.0f B/s, %.2f%% utilisation (driver wrote %u bytes)\n",
+           line_bytes * 1e6 / elapsed_us, 100.0f * instrument.linkUtilisation(line_bytes, elapsed_us),
+           instrument.txBytesWritten() - start_tx);
+    printf("science     : %llu frames of %u bytes, %.2f%% of the line\n", (unsigned long long)sci_frames,
+           instrument.scienceSize(), 100.0 * sci_bytes / line_bytes);
+    printf("housekeeping: %llu frames, %u dropped\n", (unsigned long long)hk_frames,
+           (unsigned)instrument.txQueueDropped());
+    printf("checks      : %llu crc, %llu sequence, %llu payload errors\n", (unsigned long long)crc_errors,
+           (unsigned long long)seq_gaps, (unsigned long long)ramp_errors);
+    printf("host cost   : %.2f ns/byte in txDrain\n", drain_seconds * 1e9 / line_bytes);
+
+    // Double buffering should keep the line full, housekeeping must still get through
+    if(crc_errors || seq_gaps || ramp_errors || sci_frames == 0 || hk_frames == 0 ||
+       instrument.linkUtilisation(line_bytes, elapsed_us) < 0.95f) {
+        printf("FAIL\n");
+        return 1;
+    }
+    return 0;
+}
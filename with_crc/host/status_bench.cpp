@@ -0,0 +1,134 @@
+/* status_bench.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Runs the status scheduler on the virtual clock with uneven loop() passes and occasional stalls, the OBC
+silent for the first half and sending time once a second after that. Checks status cadence, MET and that
+received time is applied, and reports status jitter.
+Usage: status_bench [status period ms] [seconds] */
+
+/********************
+Includes
+*********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "itf_frame.h"
+
+/********************
+Constants
+*********************/
+const uint16_t K_BENCH_DEFAULT_PERIOD_MS = 1000;
+const uint32_t K_BENCH_DEFAULT_SECONDS = 60;
+const uint32_t K_BENCH_PASS_MAX_US = 200;        // Longest ordinary loop() pass
+const uint32_t K_BENCH_STALL_US = 2000;          // Occasional long pass, a science frame build or uplink burst
+const uint32_t K_BENCH_STALL_ODDS = 1000;        // One pass in this many stalls
+const uint32_t K_BENCH_TIME_BASE = 700000000;    // Spacecraft time sent once the OBC starts talking
+
+/********************
+Global Variables
+*********************/
+SerialPort instrument_port;                      // Loopback the bench drives
+InstrumentSim instrument(instrument_port);
+
+uint64_t status_seen = 0;
+uint32_t status_time = 0;                        // Time tag of the last status
+uint32_t status_frames = 0;                      // SOFTWARE counters of the last status
+uint16_t status_loop_us = 0;
+uint16_t status_late_max_us = 0;
+
+/**********************************************************************************************************************
+* Function      : void checkWire()
+* Description   : Counts status frames in the TX capture and keeps the last time tag and counters
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+void checkWire() {
+    const uint8_t *tx = instrument_port.txData();
+    size_t size = instrument_port.txSize();
+    size_t pos = 0;
+    while(pos + K_TLM_HEADER_SIZE <= size) {
+        const uint8_t *tlm = &tx[pos];
+        if((((tlm[6] & 0x07) << 8) | tlm[7]) == K_STATUS_APID) {
+            status_seen++;
+            status_time = ((uint32_t)tlm[12] << 24) | ((uint32_t)tlm[13] << 16) | (tlm[14] << 8) | tlm[15];
+            status_frames = ((uint32_t)tlm[106] << 24) | ((uint32_t)tlm[107] << 16) | (tlm[108] << 8) | tlm[109];
+            status_loop_us = (tlm[130] << 8) | tlm[131];
+            status_late_max_us = (tlm[134] << 8) | tlm[135];
+        }
+        pos += (((tx[pos + 4] & 0x1F) << 8) | tx[pos + 5]) + K_INS_DATA_LEN_OFFSET;
+    }
+    instrument_port.clearTx();
+}
+
+int main(int argc, char **argv) {
+    uint16_t period_ms = K_BENCH_DEFAULT_PERIOD_MS;
+    uint32_t seconds = K_BENCH_DEFAULT_SECONDS;
+    if(argc > 1) {
+        period_ms = strtoul(argv[1], NULL, 0);
+    }
+    if(argc > 2) {
+        seconds = strtoul(argv[2], NULL, 0);
+    }
+
+    srand(1);
+    instrument.statusBegin();
+
+    // Set the rate the way the OBC would, nothing else is sent until half way
+    uint8_t rate_args[K_CMD_STATUS_RATE_ARGS] = {(uint8_t)(period_ms >> 8), (uint8_t)period_ms};
+    ItfCommand rate_cmd = {K_INS_CMD_STATUS_RATE, 0, K_CMD_STATUS_RATE_ARGS, rate_args};
+    uint8_t frame[K_MAX_PACKET_SIZE];
+    instrument_port.feed(frame, buildItfFrame(frame, 0, &rate_cmd, 1, false));
+    instrument.getData();
+    instrument.txDrain();
+    instrument_port.clearTx();
+    uint32_t start_us = micros();
+
+    uint32_t uplink_second = seconds / 2;
+    uint32_t sent_time = 0;
+    uint32_t sent_frames = 1;
+    while(micros() - start_us < seconds * 1000000) {
+        uint32_t pass_us = 1 + rand() % K_BENCH_PASS_MAX_US;
+        if(rand() % K_BENCH_STALL_ODDS == 0) {
+            pass_us = K_BENCH_STALL_US;
+        }
+        hostAdvanceMicros(pass_us);
+
+        // Mid-second, like the OBC sending the time of the next 1 pps
+        uint32_t elapsed_us = micros() - start_us;
+        if(elapsed_us / 1000000 >= uplink_second && elapsed_us % 1000000 >= 500000) {
+            uplink_second++;
+            sent_time = K_BENCH_TIME_BASE + uplink_second;
+            instrument_port.feed(frame, buildItfFrame(frame, sent_time, NULL, 0, true));
+            sent_frames++;
+        }
+
+        instrument.loopTimer();
+        instrument.getData();
+        instrument.statusService();
+        instrument.txDrain();
+        checkWire();
+    }
+
+    const SCHEDULE &sched = instrument.statusSchedule();
+    uint64_t expected = (uint64_t)seconds * 1000 / period_ms;
+    printf("status      : %llu sent every %u ms, %llu expected\n", (unsigned long long)status_seen, period_ms,
+           (unsigned long long)expected);
+    printf("jitter      : %u us max, %.1f us mean, %u missed periods\n", sched.late_max_us,
+           (double)sched.late_sum_us / sched.ticks, sched.missed);
+    printf("time        : last status %u, last time sent %u\n", status_time, sent_time);
+    printf("counters    : %u frames accepted of %u sent, %u us longest pass, %u us worst lateness\n",
+           status_frames, sent_frames, status_loop_us, status_late_max_us);
+
+    // Status keeps going with the OBC silent, every period is sent or counted missed, none is later than the
+    // longest pass, and status carries the time sent for the 1 pps it was sent at. The last status can be up to
+    // one ITF behind and its counters must agree with the scheduler
+    if(status_seen + sched.missed + 1 < expected || status_seen > expected || sched.late_max_us > K_BENCH_STALL_US ||
+       status_time != sent_time || status_frames + 1 < sent_frames || status_frames > sent_frames ||
+       status_loop_us == 0 || status_loop_us > K_BENCH_STALL_US || status_late_max_us != sched.late_max_us) {
+        printf("FAIL\n");
+        return 1;
+    }
+    return 0;
+}
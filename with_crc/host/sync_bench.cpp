@@ -0,0 +1,212 @@
+/* sync_bench.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Idle sync search on noisy lines. Each profile is mostly line noise with a valid ITF every few KiB. Some ITFs
+are led by partial syncs (FE, FE FA, FE FA 30) that overlap the real one. The stream is fed in uneven chunks
+so syncs straddle getData() calls. Every ITF must be echoed with no alarms. The telemetry digest is the same
+with the bulk scan and frame fast path on or off: make sync builds a copy with -DINSTRUMENT_SYNC_SCAN=0 and
+-DINSTRUMENT_FRAME_FAST=0 and pins this one to it.
+Usage: sync_bench [megabytes per profile] [digest] */
+
+/********************
+Includes
+*********************/
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "bench_rng.h"
+#include "itf_frame.h"
+
+/********************
+Constants
+*********************/
+const uint32_t K_BENCH_DEFAULT_MB = 16;
+const uint32_t K_BENCH_FRAME_GAP = 4096;         // Mean noise bytes between ITFs, never under half
+const uint32_t K_BENCH_MAX_FEED = 2048;          // Largest chunk handed to the loopback, two ITFs at most
+const uint64_t K_BENCH_FNV_SEED = 0xCBF29CE484222325ULL;
+const uint64_t K_BENCH_FNV_PRIME = 0x100000001B3ULL;
+
+/********************
+Structures
+*********************/
+typedef enum NOISE_PROFILE {
+    NOISE_RANDOM = 0,                            // Uniform bytes, 1 in 256 leads a sync
+    NOISE_LEADS = 1,                             // Three in four bytes from the sync, partial syncs everywhere
+    NOISE_IDLE = 2,                              // Idle fill, 0x00 or 0xFF runs
+    NOISE_PROFILES = 3,
+} NOISE_PROFILE;
+
+/********************
+Global Variables
+*********************/
+SerialPort instrument_port;                      // Loopback the bench drives
+InstrumentSim instrument(instrument_port);
+
+const char *const profile_names[NOISE_PROFILES] = {"random", "sync leads", "idle fill"};
+uint64_t rng_state = 1;
+
+// Telemetry seen on the loopback
+uint64_t tlm_echo = 0;
+uint64_t tlm_alarm = 0;
+uint64_t tlm_other = 0;
+uint64_t tlm_digest = K_BENCH_FNV_SEED;          // FNV-1a over every telemetry byte
+
+/**********************************************************************************************************************
+* Function      : uint8_t noiseByte(NOISE_PROFILE profile, uint32_t window)
+* Description   : Next noise byte for a profile, never one that completes a sync in window
+* Arguments     : NOISE_PROFILE profile, uint32_t window - the last bytes of the stream
+* Returns       : uint8_t
+**********************************************************************************************************************/
+uint8_t noiseByte(NOISE_PROFILE profile, uint32_t window) {
+    static const uint8_t sync_bytes[4] = {0xFE, 0xFA, 0x30, 0xC8};
+    uint8_t value;
+    do {
+        uint64_t r = rngNext(rng_state);
+        switch(profile) {
+        case NOISE_LEADS:
+            value = (r & 0x0F) < 12 ? sync_bytes[(r >> 4) & 0x03] : (uint8_t)(r >> 8);
+            break;
+        case NOISE_IDLE:
+            // 0xFF with the odd run of 0x00
+            value = (window & 0xFF) == 0x00 ? 0x00 : 0xFF;
+            if((r & 0xFF) == 0) {
+                value = ~value;
+            }
+            break;
+        default:
+            value = (uint8_t)r;
+            break;
+        }
+    } while(((window << 8) | value) == SYNC);
+    return value;
+}
+
+/**********************************************************************************************************************
+* Function      : uint64_t buildStream(std::vector<uint8_t>& stream, NOISE_PROFILE profile, size_t bytes)
+* Description   : Fills stream with noise and ITFs, some led by partial syncs
+* Arguments     : std::vector<uint8_t>& stream, NOISE_PROFILE profile, size_t bytes - stream size to reach
+* Returns       : uint64_t - commands in the stream
+**********************************************************************************************************************/
+uint64_t buildStream(std::vector<uint8_t> &stream, NOISE_PROFILE profile, size_t bytes) {
+    static const uint8_t partial_syncs[4][3] = {{0}, {0xFE}, {0xFE, 0xFA}, {0xFE, 0xFA, 0x30}};
+    uint8_t args[K_ECHO_MAX_ARGS];
+    for(uint8_t a = 0; a < K_ECHO_MAX_ARGS; a++) {
+        args[a] = (uint8_t)(a * 13 + 5);
+    }
+
+    stream.clear();
+    uint64_t commands = 0;
+    uint32_t window = 0;
+    uint32_t frame_time = 0;
+    while(stream.size() < bytes) {
+        size_t gap = K_BENCH_FRAME_GAP / 2 + rngNext(rng_state) % K_BENCH_FRAME_GAP;
+        for(size_t n = 0; n < gap; n++) {
+            uint8_t value = noiseByte(profile, window);
+            stream.push_back(value);
+            window = (window << 8) | value;
+        }
+
+        // Partial sync just ahead of the real one
+        uint8_t partial = rngNext(rng_state) % 4;
+        stream.insert(stream.end(), partial_syncs[partial], partial_syncs[partial] + partial);
+
+        ItfCommand cmds[3];
+        uint8_t cmd_count = 1 + rngNext(rng_state) % 3;
+        for(uint8_t c = 0; c < cmd_count; c++) {
+            cmds[c] = {(uint8_t)(0x80 + c), 0, (uint8_t)(rngNext(rng_state) % (K_ECHO_MAX_ARGS + 1)), args};
+        }
+        uint8_t frame[K_MAX_PACKET_SIZE];
+        size_t size = buildItfFrame(frame, frame_time++, cmds, cmd_count, true);
+        stream.insert(stream.end(), frame, frame + size);
+        commands += cmd_count;
+        window = ((uint32_t)frame[size - 4] << 24) | ((uint32_t)frame[size - 3] << 16) |
+                 ((uint32_t)frame[size - 2] << 8) | frame[size - 1];
+    }
+    return commands;
+}
+
+/**********************************************************************************************************************
+* Function      : void tallyTelemetry()
+* Description   : Counts the telemetry in the loopback TX capture, adds it to the digest, then clears it
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+void tallyTelemetry() {
+    const uint8_t *tx = instrument_port.txData();
+    size_t size = instrument_port.txSize();
+    size_t pos = 0;
+    while(pos + K_TLM_HEADER_SIZE <= size) {
+        uint16_t apid = ((tx[pos + 6] & 0x07) << 8) | tx[pos + 7];
+        if(apid == K_ECHO_APID) {
+            tlm_echo++;
+        }else if(apid == K_ALARM_APID) {
+            tlm_alarm++;
+        }else {
+            tlm_other++;
+        }
+        pos += (((tx[pos + 4] & 0x1F) << 8) | tx[pos + 5]) + K_INS_DATA_LEN_OFFSET;
+    }
+
+    for(size_t i = 0; i < size; i++) {
+        tlm_digest = (tlm_digest ^ tx[i]) * K_BENCH_FNV_PRIME;
+    }
+    instrument_port.clearTx();
+}
+
+int main(int argc, char **argv) {
+    uint32_t megabytes = K_BENCH_DEFAULT_MB;
+    if(argc > 1 && strtoul(argv[1], NULL, 0) != 0) {
+        megabytes = strtoul(argv[1], NULL, 0);
+    }
+    bool pin_digest = argc > 2;
+    uint64_t expect_digest = pin_digest ? strtoull(argv[2], NULL, 16) : 0;
+
+    printf("sync scan   : %s, frame fast path %s, %u MB per profile\n", INSTRUMENT_SYNC_SCAN ? "bulk" : "off",
+           INSTRUMENT_FRAME_FAST ? "on" : "off", megabytes);
+    printf("%-12s %10s %10s %10s %10s %8s\n", "profile", "ns/byte", "MB/s", "echoes", "expected", "alarms");
+
+    bool pass = true;
+    std::vector<uint8_t> stream;
+    for(uint8_t p = 0; p < NOISE_PROFILES; p++) {
+        uint64_t commands = buildStream(stream, (NOISE_PROFILE)p, (size_t)megabytes << 20);
+        uint64_t echo_start = tlm_echo;
+        uint64_t alarm_start = tlm_alarm;
+
+        double seconds = 0;
+        size_t pos = 0;
+        while(pos < stream.size()) {
+            size_t len = 1 + rngNext(rng_state) % K_BENCH_MAX_FEED;
+            if(len > stream.size() - pos) {
+                len = stream.size() - pos;
+            }
+            instrument_port.feed(&stream[pos], len);
+            pos += len;
+            auto start = std::chrono::steady_clock::now();
+            instrument.getData();
+            instrument.txDrain();
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            tallyTelemetry();
+        }
+
+        uint64_t echoes = tlm_echo - echo_start;
+        uint64_t alarms = tlm_alarm - alarm_start;
+        printf("%-12s %10.2f %10.0f %10llu %10llu %8llu\n", profile_names[p], seconds * 1e9 / stream.size(),
+               stream.size() / seconds / 1e6, (unsigned long long)echoes, (unsigned long long)commands,
+               (unsigned long long)alarms);
+        if(echoes != commands || alarms != 0) {
+            pass = false;
+        }
+    }
+    printf("telemetry   : %llu other, %u dropped, digest %016llx\n", (unsigned long long)tlm_other,
+           (unsigned)instrument.txQueueDropped(), (unsigned long long)tlm_digest);
+
+    if(!pass || tlm_other != 0 || instrument.txQueueDropped() != 0 || (pin_digest && tlm_digest != expect_digest)) {
+        printf("FAIL\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,243 @@
+/* tlm_decode.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Decodes telemetry frames in the layout tlmHeader() and the packet builders write:
+    0-3     sync
+    4       alive, power down, spare, length high (5 bits)
+    5       length low, frame size - 6
+    6-7     version, type, secondary, APID
+    8-9     grouping, sequence count
+    10-11   CCSDS length, frame size - 12 for a single echo
+    12-15   time tag
+    16-     packet, or back to back echo packets from 6 in an echo batch
+    last 2  checksum over bytes 4 onward, then the pad for an echo with an odd argument count */
+
+/********************
+Includes
+*********************/
+#include "tlm_decode.h"
+
+/**********************************************************************************************************************
+* Function      : uint16_t tlmGet16(const uint8_t* field)
+* Description   : Reads a big endian TLM field
+* Arguments     : const uint8_t* field
+* Returns       : uint16_t, tlmGet32 - uint32_t
+**********************************************************************************************************************/
+static inline uint16_t tlmGet16(const uint8_t *field) {
+    return (uint16_t)((field[0] << 8) | field[1]);
+}
+
+static inline uint32_t tlmGet32(const uint8_t *field) {
+    return ((uint32_t)field[0] << 24) | ((uint32_t)field[1] << 16) | ((uint32_t)field[2] << 8) | field[3];
+}
+
+// A single echo gives the bytes after its CCSDS length field, a batch packet the standard length - 1
+static inline bool tlmEchoSingle(const uint8_t *frame, uint16_t size) {
+    return tlmGet16(&frame[10]) == size - 12;
+}
+
+/**********************************************************************************************************************
+* Function      : TlmCursor tlmDecodeBegin(const uint8_t* data, size_t size, bool last)
+* Description   : Cursor at the start of a buffer
+* Arguments     : const uint8_t* data, size_t size, bool last - no more bytes will follow these
+* Returns       : TlmCursor
+**********************************************************************************************************************/
+TlmCursor tlmDecodeBegin(const uint8_t *data, size_t size, bool last) {
+    TlmCursor cursor = {};
+    cursor.data = data;
+    cursor.size = size;
+    cursor.last = last;
+    return cursor;
+}
+
+/**********************************************************************************************************************
+* Function      : template<class CHECKSUM> bool tlmDecodeNext(TlmCursor& cursor, TlmFrame& frame)
+* Description   : Finds the next frame that passes the checksum
+* Arguments     : TlmCursor& cursor, TlmFrame& frame - points into cursor.data
+* Returns       : bool - false once the buffer holds no more complete frames
+* Remarks       : A sync whose header is out of range or whose frame fails the checksum is taken as false, the
+*                 search goes on from the byte after it so a real sync inside is not lost
+**********************************************************************************************************************/
+template <class CHECKSUM>
+bool tlmDecodeNext(TlmCursor &cursor, TlmFrame &frame) {
+    const uint8_t *data = cursor.data;
+    size_t pos = cursor.offset;
+    while(pos < cursor.size) {
+        // Next sync lead, bytes before it are line noise
+        const uint8_t *lead = (const uint8_t *)memchr(&data[pos], (SYNC >> 24) & 0xFF, cursor.size - pos);
+        size_t found = lead == NULL ? cursor.size : (size_t)(lead - data);
+        cursor.skipped += found - pos;
+        pos = found;
+        if(pos + K_TLM_HEADER_SIZE > cursor.size) {
+            break;
+        }
+        const uint8_t *f = &data[pos];
+        if(tlmGet32(f) != SYNC) {
+            cursor.skipped++;
+            pos++;
+            continue;
+        }
+
+        uint16_t size = (((f[4] & 0x1F) << 8) | f[5]) + K_INS_DATA_LEN_OFFSET;
+        bool valid = size >= K_TLM_HEADER_SIZE + 2 && size <= K_MAX_TLM_SIZE && size % 2 == 0 &&
+                     (f[6] & 0xF8) == 0x08;
+        if(valid && pos + size > cursor.size) {
+            if(!cursor.last) {
+                break;
+            }
+            valid = false;
+        }
+        uint16_t apid = ((f[6] & 0x07) << 8) | f[7];
+        uint16_t trailer = size - 2;
+        if(valid && CHECKSUM::verified) {
+            // One pass up to the byte before the trailer. A single echo that ends in a zero may be an odd one,
+            // whose checksum covers a zero in place of its first byte and is followed by the pad. A trailer that
+            // checks both ways is far more often the odd layout, a zero pad is always there but a zero checksum
+            // byte is 1 in 256.
+            uint16_t base = CHECKSUM::update(CHECKSUM::seed, &f[K_TLM_CRC_OFFSET], size - K_TLM_CRC_OFFSET - 3);
+            bool echo = (apid & (K_TLM_APIDS_PER_INSTRUMENT - 1)) == TLM_ECHO && tlmEchoSingle(f, size);
+            if(echo && f[size - 1] == 0x00 && CHECKSUM::step(base, 0x00) == tlmGet16(&f[size - 3])) {
+                trailer = size - 3;
+            }else {
+                valid = CHECKSUM::step(base, f[size - 3]) == tlmGet16(&f[size - 2]);
+            }
+        }
+        if(!valid) {
+            cursor.bad_checks++;
+            cursor.skipped++;
+            pos++;
+            continue;
+        }
+
+        frame.data = f;
+        frame.size = size;
+        frame.trailer = trailer;
+        frame.apid = apid;
+        // Up to 8 instruments from K_APID_BASE
+        bool ours = (apid & ~0x7F) == K_APID_BASE;
+        frame.instrument = ours ? (apid - K_APID_BASE) / K_TLM_APIDS_PER_INSTRUMENT : 0;
+        frame.kind = ours ? (TLM_KIND)(apid & (K_TLM_APIDS_PER_INSTRUMENT - 1)) : TLM_OTHER;
+        frame.sequence = tlmGet16(&f[8]) & 0x3FFF;
+        frame.time = tlmGet32(&f[12]);
+        frame.alive = (f[4] & 0x80) != 0;
+        frame.power = (f[4] & 0x40) != 0;
+        cursor.offset = pos + size;
+        cursor.frames++;
+        return true;
+    }
+
+    // Out of complete frames, what is left may be the start of one
+    if(cursor.last) {
+        cursor.skipped += cursor.size - pos;
+        pos = cursor.size;
+    }
+    cursor.offset = pos;
+    return false;
+}
+
+/**********************************************************************************************************************
+* Function      : bool tlmDecodeEcho(const TlmFrame& frame, uint16_t& offset, TlmEcho& echo)
+* Description   : Steps through the echoes in a single echo or echo batch frame
+* Arguments     : const TlmFrame& frame, uint16_t& offset - 0 for the first, TlmEcho& echo - args point into frame
+* Returns       : bool - false once every echo has been read, or if the frame isn't an echo
+**********************************************************************************************************************/
+bool tlmDecodeEcho(const TlmFrame &frame, uint16_t &offset, TlmEcho &echo) {
+    const uint8_t *f = frame.data;
+    if(frame.kind != TLM_ECHO || offset >= frame.trailer) {
+        return false;
+    }
+
+    const uint8_t *ccsds;
+    uint16_t arg_count;
+    if(tlmEchoSingle(f, frame.size)) {
+        ccsds = &f[6];
+        arg_count = frame.trailer - K_ECHO_HEADER_SIZE - 2;
+        offset = frame.trailer;
+    }else {
+        // Batch, packets from 6 up to the pad or trailer
+        if(offset == 0) {
+            offset = 6;
+        }
+        if(offset + K_ECHO_CCSDS_HEADER_SIZE > frame.trailer) {
+            offset = frame.trailer;
+            return false;
+        }
+        ccsds = &f[offset];
+        uint16_t packet_size = tlmGet16(&ccsds[4]) + 7;
+        if(packet_size < K_ECHO_CCSDS_HEADER_SIZE || offset + packet_size > frame.trailer) {
+            offset = frame.trailer;
+            return false;
+        }
+        arg_count = packet_size - K_ECHO_CCSDS_HEADER_SIZE;
+        offset += packet_size;
+    }
+
+    echo.sequence = tlmGet16(&ccsds[2]) & 0x3FFF;
+    echo.time = tlmGet32(&ccsds[6]);
+    echo.macro = ccsds[10] >> 7;
+    echo.result = ccsds[10] & 0x7F;
+    echo.opcode = ccsds[11];
+    echo.args.data = &ccsds[12];
+    echo.args.size = arg_count;
+    return true;
+}
+
+/**********************************************************************************************************************
+* Function      : bool tlmDecodeAlarm(const TlmFrame& frame, TlmAlarm& alarm)
+* Description   : Reads an alarm packet
+* Arguments     : const TlmFrame& frame, TlmAlarm& alarm
+* Returns       : bool - false if the frame isn't an alarm
+**********************************************************************************************************************/
+bool tlmDecodeAlarm(const TlmFrame &frame, TlmAlarm &alarm) {
+    if(frame.kind != TLM_ALARM || frame.size != AlarmLayout::size) {
+        return false;
+    }
+    alarm.id = frame.data[16];
+    alarm.type = frame.data[17];
+    alarm.value = frame.data[18];
+    alarm.aux = frame.data[19];
+    return true;
+}
+
+/**********************************************************************************************************************
+* Function      : bool tlmDecodeStatus(const TlmFrame& frame, TlmStatus& status)
+* Description   : Reads a status packet, ANALOG and DIGITAL as views and SOFTWARE field by field
+* Arguments     : const TlmFrame& frame, TlmStatus& status
+* Returns       : bool - false if the frame isn't a status
+**********************************************************************************************************************/
+bool tlmDecodeStatus(const TlmFrame &frame, TlmStatus &status) {
+    if(frame.kind != TLM_STATUS || frame.size != StatusLayout::size) {
+        return false;
+    }
+    const uint8_t *f = frame.data;
+    status.analog.data = &f[K_TLM_ANALOG_OFFSET];
+    status.analog.size = K_TLM_ANALOG_SIZE;
+    status.digital.data = &f[K_TLM_DIGITAL_OFFSET];
+    status.digital.size = K_TLM_DIGITAL_SIZE;
+
+    const uint8_t *software = &f[K_TLM_SOFTWARE_OFFSET];
+    status.rx_bytes = tlmGet32(&software[0]);
+    status.rx_frames = tlmGet32(&software[4]);
+    for(uint8_t type = 0; type < ALARM_TYPES; type++) {
+        status.alarm_counts[type] = tlmGet16(&software[8 + 2 * type]);
+    }
+    status.cmd_executed = tlmGet32(&software[18]);
+    status.tx_high_water = software[22];
+    status.tx_depth = software[23];
+    status.tx_dropped = tlmGet16(&software[24]);
+    status.rx_overruns = tlmGet16(&software[26]);
+    status.loop_max_us = tlmGet16(&software[28]);
+    status.late_us = tlmGet16(&software[30]);
+    status.late_max_us = tlmGet16(&software[32]);
+    status.science_sent = tlmGet16(&software[34]);
+    return true;
+}
+
+// Policies a bench may build the driver with
+template bool tlmDecodeNext<ChecksumBasic>(TlmCursor &cursor, TlmFrame &frame);
+template bool tlmDecodeNext<ChecksumCrcTable>(TlmCursor &cursor, TlmFrame &frame);
+template bool tlmDecodeNext<ChecksumCrcSlice>(TlmCursor &cursor, TlmFrame &frame);
+template bool tlmDecodeNext<ChecksumNone>(TlmCursor &cursor, TlmFrame &frame);
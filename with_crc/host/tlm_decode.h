@@ -0,0 +1,126 @@
+/* tlm_decode.h
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Ground side decoder for the telemetry the driver sends, for benches that check status(), echo() and alarm()
+at high rate. tlmDecodeNext() re-syncs on SYNC and returns each frame as a view into the caller's buffer, the
+whole frame checked with one CHECKSUM::update() call (crcUpdate() folds it with carry-less multiply on x86).
+tlmDecodeEcho(), tlmDecodeAlarm() and tlmDecodeStatus() read the packets of a frame in place.
+NOTES: frames may straddle reads. When tlmDecodeNext() returns false, cursor.offset is the first byte it still
+needs, keep the buffer from there and append the next read. With cursor.last set a frame cut off by the end
+of the buffer is treated as a false sync instead. ChecksumNone and ChecksumBasic can't tell where an odd
+echo's pad is, its arguments run up to the last 2 bytes */
+
+#ifndef TLM_DECODE_H
+#define TLM_DECODE_H
+
+/********************
+Includes
+*********************/
+#include "instrument_driver.h"
+
+/********************
+Constants
+*********************/
+const uint8_t K_TLM_SYNC_SIZE = 4;
+const uint8_t K_TLM_APIDS_PER_INSTRUMENT = 0x10;   // instrumentApids() steps each instrument by this
+const uint8_t K_TLM_SOFTWARE_OFFSET = 102;         // SOFTWARE section of status
+const uint8_t K_TLM_ANALOG_OFFSET = 16;
+const uint8_t K_TLM_ANALOG_SIZE = 32;
+const uint8_t K_TLM_DIGITAL_OFFSET = 48;
+const uint8_t K_TLM_DIGITAL_SIZE = 54;
+
+/********************
+Enums
+*********************/
+// APID less the instrument's base
+typedef enum TLM_KIND {
+    TLM_OTHER = 0,
+    TLM_ECHO = K_ECHO_APID - K_APID_BASE,
+    TLM_ALARM = K_ALARM_APID - K_APID_BASE,
+    TLM_LINK = K_LINK_APID - K_APID_BASE,
+    TLM_STATUS = K_STATUS_APID - K_APID_BASE,
+    TLM_SCIENCE = K_SCIENCE_APID - K_APID_BASE,
+    TLM_DIAG = K_DIAG_APID - K_APID_BASE,
+} TLM_KIND;
+
+/********************
+Structures
+*********************/
+// Bytes in the caller's buffer
+typedef struct TlmBytes {
+    const uint8_t *data;
+    uint16_t size;
+} TlmBytes;
+
+typedef struct TlmFrame {
+    const uint8_t *data;                           // Sync onwards
+    uint16_t size;                                 // Whole frame, pad and trailer included
+    uint16_t trailer;                              // Offset of the checksum, size - 3 for an echo with a pad
+    uint16_t apid;
+    uint8_t instrument;                            // Counted from K_APID_BASE
+    TLM_KIND kind;
+    uint16_t sequence;                             // First packet's in an echo batch
+    uint32_t time;                                 // Time tag, first packet's in an echo batch
+    bool alive;
+    bool power;
+} TlmFrame;
+
+// Position of the decoder in a buffer, and what it has found so far
+typedef struct TlmCursor {
+    const uint8_t *data;
+    size_t size;
+    size_t offset;                                 // Next byte to look at
+    bool last;                                     // Nothing will be appended after size
+    uint64_t frames;                               // Frames returned
+    uint64_t bad_checks;                           // Syncs whose frame failed the checksum
+    uint64_t skipped;                              // Bytes that were not part of a returned frame
+} TlmCursor;
+
+typedef struct TlmEcho {
+    uint16_t sequence;
+    uint32_t time;
+    uint8_t macro;
+    uint8_t result;
+    uint8_t opcode;
+    TlmBytes args;                                 // At most K_ECHO_MAX_ARGS, the echo cuts the rest
+} TlmEcho;
+
+typedef struct TlmAlarm {
+    uint8_t id;
+    uint8_t type;
+    uint8_t value;                                 // ALARM_STATE + 1
+    uint8_t aux;                                   // Occurrences the packet stands for
+} TlmAlarm;
+
+// SOFTWARE section, see status() for the byte layout
+typedef struct TlmStatus {
+    TlmBytes analog;
+    TlmBytes digital;
+    uint32_t rx_bytes;
+    uint32_t rx_frames;
+    uint16_t alarm_counts[ALARM_TYPES];
+    uint32_t cmd_executed;
+    uint8_t tx_high_water;
+    uint8_t tx_depth;
+    uint16_t tx_dropped;
+    uint16_t rx_overruns;
+    uint16_t loop_max_us;
+    uint16_t late_us;
+    uint16_t late_max_us;
+    uint16_t science_sent;
+} TlmStatus;
+
+/********************
+Functions
+*********************/
+TlmCursor tlmDecodeBegin(const uint8_t *data, size_t size, bool last);
+template <class CHECKSUM>
+bool tlmDecodeNext(TlmCursor &cursor, TlmFrame &frame);
+bool tlmDecodeEcho(const TlmFrame &frame, uint16_t &offset, TlmEcho &echo);
+bool tlmDecodeAlarm(const TlmFrame &frame, TlmAlarm &alarm);
+bool tlmDecodeStatus(const TlmFrame &frame, TlmStatus &status);
+
+#endif
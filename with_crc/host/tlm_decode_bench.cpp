@@ -0,0 +1,339 @@
+/* tlm_decode_bench.cpp
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Ground decoder throughput. Records the telemetry of a busy instrument: status every 10 ms, ITFs of 1 to 10
+commands with single and batched echoes, and a checksum alarm for every corrupted ITF. Line noise and damaged
+copies of frames go between the frames. It decodes the recording in place with tlmDecodeNext() and reports the
+rate against the line. Every echo, alarm and status must be found, sequence counts must run unbroken, and no
+damaged copy may get through. A second pass reads in uneven chunks and must decode the same.
+Usage: tlm_decode_bench [megabytes] [passes] */
+
+/********************
+Includes
+*********************/
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "bench_rng.h"
+#include "itf_frame.h"
+#include "tlm_decode.h"
+
+/********************
+Constants
+*********************/
+const uint32_t K_BENCH_DEFAULT_MB = 64;
+const uint32_t K_BENCH_DEFAULT_PASSES = 5;
+const uint32_t K_BENCH_VARIANTS = 64;            // Distinct ITFs cycled through
+const uint32_t K_BENCH_PASS_US = 1000;           // Virtual time per loop() pass, one ITF each
+const uint16_t K_BENCH_STATUS_MS = 10;
+const uint32_t K_BENCH_CORRUPT_ITF = 97;         // One ITF in this many fails its CRC
+const uint32_t K_BENCH_MODE_PASSES = 20000;      // Echo batching toggles this often
+const uint32_t K_BENCH_DAMAGE_ODDS = 16;         // One frame in this many is followed by a damaged copy
+const uint32_t K_BENCH_NOISE_MAX = 48;           // Most noise bytes after a pass
+const uint32_t K_BENCH_MAX_READ = 4096;          // Largest read in the chunked pass
+
+/********************
+Structures
+*********************/
+// What the decoder found, compared between passes and against what was sent
+typedef struct DecodeTally {
+    uint64_t frames;
+    uint64_t bytes;                              // Frame bytes returned
+    uint64_t echoes;
+    uint64_t echo_args;                          // Sum of every echoed argument byte
+    uint64_t alarms;
+    uint64_t checksum_alarms;
+    uint64_t status;
+    uint64_t other;
+    uint64_t sequence_breaks;
+    uint64_t status_regressions;                 // Status counters that went backwards
+    uint64_t bad_checks;
+} DecodeTally;
+
+/********************
+Global Variables
+*********************/
+SerialPort instrument_port;                      // Loopback the bench drives
+InstrumentSim instrument(instrument_port);
+
+uint8_t bench_frames[K_BENCH_VARIANTS][K_MAX_PACKET_SIZE];
+size_t bench_sizes[K_BENCH_VARIANTS];
+uint8_t bench_cmds[K_BENCH_VARIANTS];
+uint64_t bench_args[K_BENCH_VARIANTS];           // Sum of the arguments each variant's echoes carry
+uint64_t rng_state = 1;
+
+/**********************************************************************************************************************
+* Function      : void buildFrames()
+* Description   : Generates ITF variants with 1 to K_MAX_CMDS commands, odd and even argument counts
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+void buildFrames() {
+    uint8_t args[K_MAX_CMD_SIZE];
+    for(int i = 0; i < K_MAX_CMD_SIZE; i++) {
+        args[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    ItfCommand cmds[K_MAX_CMDS];
+    for(uint32_t v = 0; v < K_BENCH_VARIANTS; v++) {
+        uint8_t cmd_count = 1 + v % K_MAX_CMDS;
+        bench_args[v] = 0;
+        for(uint8_t c = 0; c < cmd_count; c++) {
+            // Opcodes without handlers, echoed as executed
+            cmds[c] = {(uint8_t)(0x80 + v + c), (uint8_t)(c & 0x01), (uint8_t)((v * 3 + c * 5) % 16), args};
+            for(uint8_t a = 0; a < cmds[c].arg_count && a < K_ECHO_MAX_ARGS; a++) {
+                bench_args[v] += args[a];
+            }
+        }
+        bench_cmds[v] = cmd_count;
+        bench_sizes[v] = buildItfFrame(bench_frames[v], v, cmds, cmd_count, true);
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : void addNoise(std::vector<uint8_t>& stream)
+* Description   : Appends line noise, sync leads included but never a whole sync
+* Arguments     : std::vector<uint8_t>& stream
+* Returns       : none
+**********************************************************************************************************************/
+void addNoise(std::vector<uint8_t> &stream) {
+    uint32_t count = rngNext(rng_state) % (K_BENCH_NOISE_MAX + 1);
+    for(uint32_t n = 0; n < count; n++) {
+        uint64_t r = rngNext(rng_state);
+        uint8_t value = (r & 0x07) == 0 ? (SYNC >> 24) & 0xFF : (uint8_t)(r >> 8);
+        size_t size = stream.size();
+        if(size >= 3 && ((stream[size - 3] << 24) | (stream[size - 2] << 16) | (stream[size - 1] << 8) | value) ==
+                        (int32_t)SYNC) {
+            value = 0x00;
+        }
+        stream.push_back(value);
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : uint64_t recordTelemetry(std::vector<uint8_t>& stream, size_t bytes, uint64_t& commands,
+*                                          uint64_t& args, uint64_t& corrupted, uint64_t& damaged)
+* Description   : Runs the instrument until stream holds bytes of telemetry, noise and damaged copies
+* Arguments     : std::vector<uint8_t>& stream, size_t bytes,
+*                 uint64_t& commands, uint64_t& args - echoes and argument sum to expect,
+*                 uint64_t& corrupted - ITFs that should raise a checksum alarm, uint64_t& damaged - copies added
+* Returns       : uint64_t - telemetry frames recorded
+**********************************************************************************************************************/
+uint64_t recordTelemetry(std::vector<uint8_t> &stream, size_t bytes, uint64_t &commands, uint64_t &args,
+                         uint64_t &corrupted, uint64_t &damaged) {
+    uint8_t frame[K_MAX_PACKET_SIZE];
+    uint8_t rate_args[K_CMD_STATUS_RATE_ARGS] = {0, K_BENCH_STATUS_MS};
+    ItfCommand rate_cmd = {K_INS_CMD_STATUS_RATE, 0, K_CMD_STATUS_RATE_ARGS, rate_args};
+    uint8_t batch = 0;
+    ItfCommand batch_cmd = {K_INS_CMD_ECHO_MODE, 0, K_CMD_ECHO_MODE_ARGS, &batch};
+
+    instrument.statusBegin();
+    instrument_port.feed(frame, buildItfFrame(frame, 0, &rate_cmd, 1, true));
+    commands = 1;
+    args = rate_args[0] + rate_args[1];
+    corrupted = damaged = 0;
+
+    uint64_t frames = 0;
+    for(uint64_t pass = 0; stream.size() < bytes; pass++) {
+        hostAdvanceMicros(K_BENCH_PASS_US);
+        if(pass % K_BENCH_MODE_PASSES == K_BENCH_MODE_PASSES - 1) {
+            batch ^= 1;
+            instrument_port.feed(frame, buildItfFrame(frame, 0, &batch_cmd, 1, true));
+            commands++;
+            args += batch;
+        }
+        uint32_t v = pass % K_BENCH_VARIANTS;
+        if(pass % K_BENCH_CORRUPT_ITF == K_BENCH_CORRUPT_ITF - 1) {
+            memcpy(frame, bench_frames[v], bench_sizes[v]);
+            frame[bench_sizes[v] - 3] ^= 0x01;
+            instrument_port.feed(frame, bench_sizes[v]);
+            corrupted++;
+        }else {
+            instrument_port.feed(bench_frames[v], bench_sizes[v]);
+            commands += bench_cmds[v];
+            args += bench_args[v];
+        }
+        instrument.service();
+
+        // Copy each frame out, sometimes followed by a damaged copy of it
+        const uint8_t *tx = instrument_port.txData();
+        size_t size = instrument_port.txSize();
+        size_t pos = 0;
+        while(pos + K_TLM_HEADER_SIZE <= size) {
+            size_t pack_size = (((tx[pos + 4] & 0x1F) << 8) | tx[pos + 5]) + K_INS_DATA_LEN_OFFSET;
+            stream.insert(stream.end(), &tx[pos], &tx[pos + pack_size]);
+            frames++;
+            if(rngNext(rng_state) % K_BENCH_DAMAGE_ODDS == 0) {
+                size_t copy = stream.size();
+                stream.insert(stream.end(), &tx[pos], &tx[pos + pack_size]);
+                stream[copy + K_TLM_SYNC_SIZE + rngNext(rng_state) % (pack_size - K_TLM_SYNC_SIZE)] ^=
+                    (uint8_t)(1 << (rngNext(rng_state) % 8));
+                damaged++;
+            }
+            pos += pack_size;
+        }
+        instrument_port.clearTx();
+        addNoise(stream);
+    }
+    return frames;
+}
+
+/**********************************************************************************************************************
+* Function      : void tallyFrame(const TlmFrame& frame, DecodeTally& tally, uint16_t& sequence, TlmStatus& last)
+* Description   : Decodes the packets of one frame into the tally
+* Arguments     : const TlmFrame& frame, DecodeTally& tally,
+*                 uint16_t& sequence - last sequence count seen, TlmStatus& last - last status seen
+* Returns       : none
+**********************************************************************************************************************/
+void tallyFrame(const TlmFrame &frame, DecodeTally &tally, uint16_t &sequence, TlmStatus &last) {
+    tally.frames++;
+    tally.bytes += frame.size;
+
+    TlmEcho echo;
+    TlmAlarm alarm;
+    TlmStatus status;
+    uint16_t offset = 0;
+    switch(frame.kind) {
+        case TLM_ECHO:
+            while(tlmDecodeEcho(frame, offset, echo)) {
+                tally.sequence_breaks += echo.sequence != ((sequence + 1) & 0x3FFF);
+                sequence = echo.sequence;
+                tally.echoes++;
+                for(uint16_t a = 0; a < echo.args.size; a++) {
+                    tally.echo_args += echo.args.data[a];
+                }
+            }
+            return;
+        case TLM_ALARM:
+            tlmDecodeAlarm(frame, alarm);
+            tally.alarms++;
+            tally.checksum_alarms += alarm.value == ITF_CHECKSUM + 1;
+            break;
+        case TLM_STATUS:
+            tlmDecodeStatus(frame, status);
+            tally.status++;
+            tally.status_regressions += status.rx_frames < last.rx_frames || status.cmd_executed < last.cmd_executed ||
+                                        status.alarm_counts[ITF_CHECKSUM] < last.alarm_counts[ITF_CHECKSUM];
+            last = status;
+            break;
+        default:
+            tally.other++;
+            break;
+    }
+    tally.sequence_breaks += frame.sequence != ((sequence + 1) & 0x3FFF);
+    sequence = frame.sequence;
+}
+
+/**********************************************************************************************************************
+* Function      : DecodeTally decodeWhole(const std::vector<uint8_t>& stream)
+* Description   : Decodes the recording in one buffer, as a mapped file would be
+* Arguments     : const std::vector<uint8_t>& stream
+* Returns       : DecodeTally
+**********************************************************************************************************************/
+DecodeTally decodeWhole(const std::vector<uint8_t> &stream) {
+    DecodeTally tally = {};
+    TlmStatus last = {};
+    uint16_t sequence = 0;
+    TlmFrame frame;
+    TlmCursor cursor = tlmDecodeBegin(stream.data(), stream.size(), true);
+    while(tlmDecodeNext<INSTRUMENT_CHECKSUM>(cursor, frame)) {
+        tallyFrame(frame, tally, sequence, last);
+    }
+    tally.bad_checks = cursor.bad_checks;
+    return tally;
+}
+
+/**********************************************************************************************************************
+* Function      : DecodeTally decodeChunked(const std::vector<uint8_t>& stream)
+* Description   : Decodes the recording as uneven reads into a buffer, keeping what the decoder still needs
+* Arguments     : const std::vector<uint8_t>& stream
+* Returns       : DecodeTally
+**********************************************************************************************************************/
+DecodeTally decodeChunked(const std::vector<uint8_t> &stream) {
+    static uint8_t buffer[K_MAX_TLM_SIZE + K_BENCH_MAX_READ];
+    DecodeTally tally = {};
+    TlmStatus last = {};
+    uint16_t sequence = 0;
+    TlmFrame frame;
+    size_t held = 0;
+    size_t pos = 0;
+    while(pos < stream.size()) {
+        size_t len = 1 + rngNext(rng_state) % K_BENCH_MAX_READ;
+        if(len > stream.size() - pos) {
+            len = stream.size() - pos;
+        }
+        memcpy(&buffer[held], &stream[pos], len);
+        held += len;
+        pos += len;
+
+        TlmCursor cursor = tlmDecodeBegin(buffer, held, pos == stream.size());
+        while(tlmDecodeNext<INSTRUMENT_CHECKSUM>(cursor, frame)) {
+            tallyFrame(frame, tally, sequence, last);
+        }
+        tally.bad_checks += cursor.bad_checks;
+        held -= cursor.offset;
+        memmove(buffer, &buffer[cursor.offset], held);
+    }
+    return tally;
+}
+
+int main(int argc, char **argv) {
+    uint32_t megabytes = K_BENCH_DEFAULT_MB;
+    uint32_t passes = K_BENCH_DEFAULT_PASSES;
+    if(argc > 1 && strtoul(argv[1], NULL, 0) != 0) {
+        megabytes = strtoul(argv[1], NULL, 0);
+    }
+    if(argc > 2 && strtoul(argv[2], NULL, 0) != 0) {
+        passes = strtoul(argv[2], NULL, 0);
+    }
+
+    buildFrames();
+    std::vector<uint8_t> stream;
+    stream.reserve(((size_t)megabytes << 20) + K_MAX_TLM_SIZE);
+    uint64_t commands, args, corrupted, damaged;
+    uint64_t sent = recordTelemetry(stream, (size_t)megabytes << 20, commands, args, corrupted, damaged);
+    printf("recording   : %zu bytes, %llu frames, %llu damaged copies, %u dropped\n", stream.size(),
+           (unsigned long long)sent, (unsigned long long)damaged, (unsigned)instrument.txQueueDropped());
+
+    DecodeTally whole = {};
+    double best = 0;
+    for(uint32_t p = 0; p < passes; p++) {
+        auto start = std::chrono::steady_clock::now();
+        whole = decodeWhole(stream);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(p == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    DecodeTally chunked = decodeChunked(stream);
+
+    double rate = stream.size() / best;
+    printf("decode      : %.2f ns/byte, %.0f MB/s, %.0f frames/s (best of %u)\n", best * 1e9 / stream.size(),
+           rate / 1e6, whole.frames / best, passes);
+    printf("line rate   : %.0fx 115200 baud, %.0fx 6 Mbaud (8O1)\n", rate / (115200.0 / 11.0),
+           rate / (6000000.0 / 11.0));
+    printf("frames      : %llu (%llu status, %llu alarm, %llu other), %llu echoes of %llu commands\n",
+           (unsigned long long)whole.frames, (unsigned long long)whole.status, (unsigned long long)whole.alarms,
+           (unsigned long long)whole.other, (unsigned long long)whole.echoes, (unsigned long long)commands);
+    printf("checks      : %llu failed, %llu sequence breaks, %llu status regressions\n",
+           (unsigned long long)whole.bad_checks, (unsigned long long)whole.sequence_breaks,
+           (unsigned long long)whole.status_regressions);
+
+    bool pass = whole.frames == sent && whole.echoes == commands && whole.echo_args == args &&
+                whole.alarms == corrupted && whole.checksum_alarms == corrupted && whole.sequence_breaks == 0 &&
+                whole.status_regressions == 0 && whole.bad_checks >= damaged && instrument.txQueueDropped() == 0;
+    bool same = memcmp(&whole, &chunked, sizeof(DecodeTally)) == 0;
+    if(!same) {
+        printf("chunked     : %llu frames, %llu echoes, %llu failed checks\n", (unsigned long long)chunked.frames,
+               (unsigned long long)chunked.echoes, (unsigned long long)chunked.bad_checks);
+    }
+    if(!pass || !same) {
+        printf("FAIL\n");
+        return 1;
+    }
+    return 0;
+}
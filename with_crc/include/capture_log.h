@@ -0,0 +1,84 @@
+/* capture_log.h
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Append-only binary ring of what the simulator received and sent, for offline analysis of OBC integration runs.
+The CaptureHeader sits at the start of the memory it is given and records follow it, so the ring is
+self-describing wherever it lives: EXTMEM (PSRAM) on the Teensy, a memory mapped file on the host.
+Each record is a CaptureRecord then its payload, padded to K_CAPTURE_ALIGN. When the ring is full the oldest
+records are overwritten, appending is a bounded copy and never waits.
+NOTES: the reader walks the ring in place with a CaptureCursor, nothing is copied out */
+
+#ifndef CAPTURE_LOG_H
+#define CAPTURE_LOG_H
+
+/********************
+Includes
+*********************/
+#include "instrument.h"
+
+/********************
+Constants
+*********************/
+const uint32_t K_CAPTURE_MAGIC = 0x50414349;      // "ICAP"
+const uint16_t K_CAPTURE_VERSION = 1;
+const uint8_t K_CAPTURE_ALIGN = 4;
+
+/********************
+Enums
+*********************/
+typedef enum CAPTURE_DIR {
+    CAPTURE_RX = 0,                                // Chunk read from the UART by getData()
+    CAPTURE_TX = 1,                                // Frame queued by sendData()
+    CAPTURE_WRAP = 0xFF,                           // Rest of the ring is unused, next record is at the start
+} CAPTURE_DIR;
+
+/********************
+Structures
+*********************/
+typedef struct CaptureHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;                          // Record area starts here
+    uint32_t capacity;                             // Record area bytes
+    uint32_t head;                                 // Where the next record goes
+    uint32_t tail;                                 // Oldest record
+    uint32_t count;                                // Records in the ring
+    uint32_t appended;                             // Records ever appended
+    uint32_t overwritten;                          // Oldest records lost to newer ones
+    uint64_t payload_bytes;                        // Payload bytes ever appended
+} CaptureHeader;
+
+typedef struct CaptureRecord {
+    uint32_t time_us;                              // micros(), the clock the latency histograms use
+    uint16_t length;                               // Payload bytes
+    uint8_t direction;                             // CAPTURE_DIR
+    uint8_t source;                                // Instrument, set by captureAttach()
+} CaptureRecord;
+
+// Position of a reader in a ring
+typedef struct CaptureCursor {
+    const uint8_t *area;
+    uint32_t capacity;
+    uint32_t offset;
+    uint32_t left;                                 // Records still to read
+} CaptureCursor;
+
+static_assert(sizeof(CaptureHeader) % K_CAPTURE_ALIGN == 0, "Records must start aligned");
+static_assert(sizeof(CaptureRecord) % K_CAPTURE_ALIGN == 0, "Payloads must start aligned");
+
+/********************
+Functions
+*********************/
+CaptureHeader* captureInit(void *memory, uint32_t size);
+void captureAppend(CaptureHeader *log, CAPTURE_DIR direction, uint8_t source, const uint8_t *data, uint16_t len);
+CaptureCursor captureBegin(const CaptureHeader *log);
+bool captureNext(CaptureCursor &cursor, const CaptureRecord *&record, const uint8_t *&payload);
+#ifndef ARDUINO
+CaptureHeader* captureMapFile(const char *path, uint32_t size);
+const CaptureHeader* captureOpenFile(const char *path);
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+/* checksum.h
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Frame checksum policies for InstrumentDriver. Every policy is a struct of static members, so the driver calls
+them directly and the compiler inlines them into the RX and TX loops:
+    seed                - running value at byte 4, the first byte after sync
+    step(check, data)   - one byte, constexpr so packet prefixes are folded at compile time
+    update(check, ...)  - a run of bytes, used on whole frames
+    verified            - false skips the uplink check, the trailer is still written
+The checksum covers bytes 4 to the end of the frame less the 2 byte trailer, which holds it big endian.
+    ChecksumBasic       - the basic variant, no uplink check and a constant 0xEB90 trailer
+    ChecksumCrcTable    - CRC-CCITT16 one table lookup per byte
+    ChecksumCrcSlice    - CRC-CCITT16 through crcUpdate(), slicing-by-8 on the Teensy
+    ChecksumNone        - no check and a zero trailer, for raw throughput tests */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+/********************
+Includes
+*********************/
+#include "crc.h"
+
+/********************
+Policies
+*********************/
+// The basic variant takes any uplink trailer and closes every frame with 0xEB90, the check never moves off it
+struct ChecksumBasic {
+    static constexpr bool verified = false;
+    static constexpr uint16_t seed = 0xEB90;
+
+    static constexpr uint16_t step(uint16_t, uint8_t) {
+        return seed;
+    }
+
+    static inline uint16_t update(uint16_t, const uint8_t *, size_t) {
+        return seed;
+    }
+};
+
+struct ChecksumCrcTable {
+    static constexpr bool verified = true;
+    static constexpr uint16_t seed = CRC_SEED;
+
+    static constexpr uint16_t step(uint16_t check, uint8_t data) {
+        return crcConst(check, data);
+    }
+
+    static inline uint16_t update(uint16_t check, const uint8_t *data, size_t len) {
+        for(size_t i = 0; i < len; i++) {
+            check = (uint16_t)((check << 8) ^ CRC_LOOKUP.table[0][((check >> 8) ^ data[i]) & 0xFF]);
+        }
+        return check;
+    }
+};
+
+struct ChecksumCrcSlice {
+    static constexpr bool verified = true;
+    static constexpr uint16_t seed = CRC_SEED;
+
+    static constexpr uint16_t step(uint16_t check, uint8_t data) {
+        return crcConst(check, data);
+    }
+
+    static inline uint16_t update(uint16_t check, const uint8_t *data, size_t len) {
+        return crcUpdate(check, data, len);
+    }
+};
+
+struct ChecksumNone {
+    static constexpr bool verified = false;
+    static constexpr uint16_t seed = 0x0000;
+
+    static constexpr uint16_t step(uint16_t check, uint8_t) {
+        return check;
+    }
+
+    static inline uint16_t update(uint16_t check, const uint8_t *, size_t) {
+        return check;
+    }
+};
+
+// Policy for the build, -DINSTRUMENT_CHECKSUM=ChecksumBasic builds the basic checksum variant
+#ifndef INSTRUMENT_CHECKSUM
+#define INSTRUMENT_CHECKSUM ChecksumCrcSlice
+#endif
+
+#endif
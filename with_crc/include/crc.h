@@ -0,0 +1,98 @@
+/* crc.h
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+CRC-CCITT16 (poly 0x1021, MSB first, no final XOR) used on every uplink and telemetry frame */
+
+#ifndef CRC_H
+#define CRC_H
+
+/********************
+Includes
+*********************/
+#include "instrument.h"
+
+/********************
+Constants
+*********************/
+const uint16_t CRC_SEED = 0xFFFF;
+const uint16_t CRC_SEED_TABLE = 0x0000;
+const uint16_t CRC_POLY = 0x1021;
+const uint8_t K_CRC_SLICES = 8;                    // Lookup tables for slicing-by-8
+
+/********************
+Structures
+*********************/
+// table[0] is the byte-wise table, table[k] advances it by k more zero bytes
+typedef struct CrcTables {
+    uint16_t table[K_CRC_SLICES][256];
+} CrcTables;
+
+/********************
+Compile Time
+*********************/
+// Bitwise CRC of one byte, for tables and constants built by the compiler
+constexpr uint16_t crcConst(uint16_t checksum, uint8_t data) {
+    // Append data into the top part of the checksum so it is the most significant
+    checksum ^= (uint16_t)(data << 8);
+
+    // Go through all of the new 8 bits and divide the polynomial
+    for(uint8_t j = 0; j < 8; j++) {
+        if(checksum & 0x8000) {
+            checksum = (uint16_t)((checksum << 1) ^ CRC_POLY);
+        }else {
+            checksum = (uint16_t)(checksum << 1);
+        }
+    }
+    return checksum;
+}
+
+constexpr CrcTables crcBuildTables() {
+    CrcTables lookup = {};
+    for(int i = 0; i < 256; i++) {
+        lookup.table[0][i] = crcConst(CRC_SEED_TABLE, (uint8_t)i);
+    }
+    // Each slice is the previous one pushed through one more zero byte
+    for(int k = 1; k < K_CRC_SLICES; k++) {
+        for(int i = 0; i < 256; i++) {
+            uint16_t prev = lookup.table[k-1][i];
+            lookup.table[k][i] = (uint16_t)((prev << 8) ^ lookup.table[0][prev >> 8]);
+        }
+    }
+    return lookup;
+}
+
+// x^n mod P
+constexpr uint16_t crcXPow(uint16_t n) {
+    uint32_t r = 1;
+    for(uint16_t i = 0; i < n; i++) {
+        r <<= 1;
+        if(r & 0x10000) {
+            r ^= 0x10000 | CRC_POLY;
+        }
+    }
+    return (uint16_t)r;
+}
+
+/********************
+Global Variables
+*********************/
+// CRC-CCITT16 Lookup, generated by the compiler into flash
+extern const CrcTables CRC_LOOKUP;
+
+/********************
+Functions
+*********************/
+uint16_t crc(uint16_t checksum, uint8_t data);
+uint16_t crcUpdate(uint16_t checksum, const uint8_t *data, size_t len);
+uint16_t crcUpdateBytewise(uint16_t checksum, const uint8_t *data, size_t len);
+uint16_t crcUpdateSlice4(uint16_t checksum, const uint8_t *data, size_t len);
+uint16_t crcUpdateSlice8(uint16_t checksum, const uint8_t *data, size_t len);
+#ifndef ARDUINO
+bool crcHasClmul(void);
+uint16_t crcUpdateClmul(uint16_t checksum, const uint8_t *data, size_t len);
+#endif
+
+#endif
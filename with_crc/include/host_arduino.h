@@ -0,0 +1,52 @@
+/* host_arduino.h
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Minimal stand-ins for the Arduino core so the driver can be built and benchmarked on a Linux host.
+Time is virtual: nothing advances it unless the host harness calls hostAdvanceMicros(). */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/********************
+Includes
+*********************/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/********************
+Constants
+*********************/
+// Everything is in RAM on the host
+#define PROGMEM
+
+/********************
+Functions
+*********************/
+// Virtual clock shared by the driver and the host harness
+inline uint32_t &hostMicros() {
+    static uint32_t now_us = 0;
+    return now_us;
+}
+
+inline void hostAdvanceMicros(uint32_t us) {
+    hostMicros() += us;
+}
+
+inline uint32_t micros() {
+    return hostMicros();
+}
+
+inline uint32_t millis() {
+    return hostMicros() / 1000;
+}
+
+// Host has no line to wait on, delays are no-ops
+inline void delay(double ms) {
+    (void)ms;
+}
+
+#endif
@@ -1,2 +1,6 @@
+#ifdef ARDUINO
 #include <Arduino.h>
-#include <stdint.h>
\ No newline at end of file
+#else
+#include "host_arduino.h"
+#endif
+#include <stdint.h>
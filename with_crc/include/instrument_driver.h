@@ -2,36 +2,183 @@
 Author:  Nevin Leh, Emma Stensland
 Date:    April 2020 */
 
+#ifndef INSTRUMENT_DRIVER_H
+#define INSTRUMENT_DRIVER_H
+
 /********************
 Includes
 *********************/
 #include "instrument.h"
+#include "serial_port.h"
+#include "checksum.h"
+#include "capture_log.h"
 
 /********************
 Constants
 *********************/
+// Uplink capacity, every buffer is sized from these. Override with -DINSTRUMENT_MAX_PACKET= (ITF bytes),
+// -DINSTRUMENT_MAX_CMDS= (commands per ITF) and -DINSTRUMENT_MAX_CMD_SIZE= (command bytes)
+#ifndef INSTRUMENT_MAX_PACKET
+#define INSTRUMENT_MAX_PACKET 512
+#endif
+#ifndef INSTRUMENT_MAX_CMDS
+#define INSTRUMENT_MAX_CMDS 10
+#endif
+#ifndef INSTRUMENT_MAX_CMD_SIZE
+#define INSTRUMENT_MAX_CMD_SIZE 246
+#endif
+
 // Sizes
-const uint16_t K_MAX_PACKET_SIZE = 512;
+const uint16_t K_MAX_PACKET_SIZE = INSTRUMENT_MAX_PACKET;
 const uint8_t K_MIN_PACKET_SIZE = 10;
-const uint16_t K_MAX_CMD_SIZE = 246;
+const uint16_t K_MAX_CMD_SIZE = INSTRUMENT_MAX_CMD_SIZE;
 const uint8_t K_MIN_CMD_SIZE = 12;
-const uint8_t K_MAX_CMDS = 10;
+const uint8_t K_MAX_CMDS = INSTRUMENT_MAX_CMDS;
 const uint8_t K_TIME_SIZE = 33;
 const uint16_t K_MAX_TLM_SIZE = 8196;
+const uint16_t K_RX_CHUNK_SIZE = 64;              // Teensy default serial RX buffer
+const uint8_t K_TLM_HEADER_SIZE = 16;              // Sync through time tag
+const uint8_t K_STATUS_SIZE = 140;
+const uint8_t K_ALARM_SIZE = 22;
+const uint8_t K_ECHO_HEADER_SIZE = K_TLM_HEADER_SIZE;
+const uint8_t K_ECHO_MAX_ARGS = 10;
+const uint8_t K_ECHO_MAX_SIZE = K_ECHO_HEADER_SIZE + 4 + K_ECHO_MAX_ARGS;
+const uint8_t K_ECHO_CCSDS_HEADER_SIZE = 12;       // Primary header, time tag, macro/result and opcode
+const uint16_t K_ECHO_BATCH_MAX_SIZE = 6 + K_MAX_CMDS * (K_ECHO_CCSDS_HEADER_SIZE + K_ECHO_MAX_ARGS) + 2;
+const uint8_t K_TX_SLOTS = K_MAX_CMDS + 6;         // Status, alarms and one echo per command of a full ITF
+// Largest housekeeping frame or echo batch
+const uint16_t K_TX_SLOT_SIZE = K_ECHO_BATCH_MAX_SIZE > K_STATUS_SIZE ? K_ECHO_BATCH_MAX_SIZE : K_STATUS_SIZE;
+const uint8_t K_SCIENCE_HEADER_SIZE = K_TLM_HEADER_SIZE + 4;   // TLM header and science frame count
+const uint16_t K_SCIENCE_MIN_SIZE = K_SCIENCE_HEADER_SIZE + 2;
+const uint8_t K_SCIENCE_BUFFS = 2;                 // Frame on the wire and the next one being built
+const uint8_t K_RX_BUFFS = 2;                      // ITF being read and the verified one waiting to run
+const uint8_t K_LINK_SIZE = 60;
+const uint8_t K_LAT_BUCKETS = 20;                  // 0 us, then powers of two up to 2^18 us and over
+const uint8_t K_DIAG_SIZE = 30 + 4 * K_LAT_BUCKETS + 2;
 
 // Offsets
 const uint8_t K_INS_DATA_LEN_OFFSET = 6;
 const uint8_t K_INS_TIME_LENGTH_OFFSET = 14;
 const uint8_t K_INS_TIME_OFFSET = 18;
 const uint8_t K_INS_HEADER_OFFSET = 10;
+const uint8_t K_TLM_CRC_OFFSET = 4;                // TLM CRC covers everything after sync
+const uint8_t K_TLM_SEQUENCE_OFFSET = 8;           // First TLM field that changes every packet
+const uint8_t K_TLM_FLAG_STATES = 4;               // Heartbeat and power combinations
+
+// APIDs, the default set, instrumentApids() moves it for more instruments
+const uint16_t K_APID_BASE = 0x300;
+const uint16_t K_ECHO_APID = 0x301;
+const uint16_t K_ALARM_APID = 0x302;
+const uint16_t K_LINK_APID = 0x303;
+const uint16_t K_STATUS_APID = 0x305;
+const uint16_t K_SCIENCE_APID = 0x306;
+const uint16_t K_DIAG_APID = 0x307;
+
+// Scheduler
+const uint32_t K_MET_PERIOD_US = 1000000;          // MET ticks once a second
+const uint32_t K_STATUS_PERIOD_US = 1000000;       // 1 pps status at power up
+const uint32_t K_DIAG_PERIOD_US = 10000000;        // Latency histograms
+
+// Alarms
+const uint8_t K_ALARM_COUNT_MAX = 0xFF;            // Occurrences one alarm packet carries, sent as soon as reached
+const uint8_t K_ALARM_BURST = 8;                   // Immediate alarms the token bucket banks
+const uint32_t K_ALARM_TOKEN_US = 10000;           // Immediate alarms refill one per period, 100 a second
+
+// Link at power up, override with -DINSTRUMENT_BAUD= and -DINSTRUMENT_FORMAT=
+#ifndef INSTRUMENT_BAUD
+#define INSTRUMENT_BAUD 115200
+#endif
+#ifndef INSTRUMENT_FORMAT
+#define INSTRUMENT_FORMAT LINK_8O1
+#endif
+
+// Idle input is searched for sync in bulk, -DINSTRUMENT_SYNC_SCAN=0 runs every byte through the FSM
+#ifndef INSTRUMENT_SYNC_SCAN
+#define INSTRUMENT_SYNC_SCAN 1
+#endif
+
+// Alarms are counted per ITF and sent as one packet per type, -DINSTRUMENT_ALARM_MODE=ALARM_IMMEDIATE sends one
+// per event through the token bucket
+#ifndef INSTRUMENT_ALARM_MODE
+#define INSTRUMENT_ALARM_MODE ALARM_COALESCE
+#endif
+
+// A frame already in the UART is checked in one pass, -DINSTRUMENT_FRAME_FAST=0 runs every byte through the FSM
+#ifndef INSTRUMENT_FRAME_FAST
+#define INSTRUMENT_FRAME_FAST 1
+#endif
 
 // Sync
 const uint32_t SYNC = 0xFEFA30C8;
 
-// CRC
-const uint16_t CRC_SEED = 0xFFFF;
-const uint16_t CRC_SEED_TABLE = 0x0000;
-const uint16_t CRC_POLY = 0x1021;
+// Opcodes, anything without a handler is echoed back as executed
+const uint8_t K_INS_CMD_ECHO = 0x00;
+const uint8_t K_INS_CMD_SURVEY = 0x01;             // Args: enable, length high, length low
+const uint8_t K_INS_CMD_BURST = 0x02;              // Args: enable, length high, length low
+const uint8_t K_INS_CMD_LINK = 0x03;               // Args: baud (4 bytes), LINK_FORMAT
+const uint8_t K_INS_CMD_LINK_TEST = 0x04;          // Args: test length in ms (2 bytes)
+const uint8_t K_INS_CMD_ECHO_MODE = 0x05;          // Args: 0 one frame per echo, 1 all echoes of an ITF in one
+const uint8_t K_INS_CMD_STATUS_RATE = 0x06;        // Args: status period in ms (2 bytes), 0 stops status
+const uint8_t K_INS_CMD_ALARM_MODE = 0x07;         // Args: ALARM_MODE, window or token period in ms (2 bytes)
+const uint16_t K_CMD_OPCODES = 256;
+const uint8_t K_CMD_MODE_ARGS = 3;
+const uint8_t K_CMD_LINK_ARGS = 5;
+const uint8_t K_CMD_LINK_TEST_ARGS = 2;
+const uint8_t K_CMD_ECHO_MODE_ARGS = 1;
+const uint8_t K_CMD_STATUS_RATE_ARGS = 2;
+const uint8_t K_CMD_ALARM_MODE_ARGS = 3;
+
+// Command results, 7 bits in the echo
+const uint8_t K_CMD_SUCCESS = 0x00;
+const uint8_t K_CMD_BAD_ARGS = 0x01;
+
+/********************
+Packet Layouts
+*********************/
+// Telemetry packet known at compile time, SIZE is the fixed size or the largest for variable packets
+template <uint16_t APID, uint16_t SIZE, uint16_t CCSDS_LENGTH>
+struct TlmLayout {
+    static constexpr uint16_t apid = APID;
+    static constexpr uint16_t size = SIZE;
+    static constexpr uint16_t ccsds_length = CCSDS_LENGTH;
+    static constexpr uint8_t apid_high = 0x08 | ((APID >> 8) & 0x07);   // Version, Type, Secondary, APID
+    static constexpr uint8_t apid_low = APID & 0xFF;
+
+    static_assert(APID <= 0x7FF, "APID is 11 bits");
+    static_assert(SIZE >= K_TLM_HEADER_SIZE + 2, "Packet needs a header and CRC");
+    static_assert(SIZE <= K_MAX_TLM_SIZE, "Packet is larger than a TLM frame");
+    static_assert(SIZE % 2 == 0, "TLM frames are padded to an even size");
+};
+
+typedef TlmLayout<K_STATUS_APID, K_STATUS_SIZE, K_STATUS_SIZE - 17> StatusLayout;
+typedef TlmLayout<K_ALARM_APID, K_ALARM_SIZE, K_ALARM_SIZE - 15> AlarmLayout;
+typedef TlmLayout<K_ECHO_APID, K_ECHO_MAX_SIZE, 0> EchoLayout;         // CCSDS length set per packet
+typedef TlmLayout<K_SCIENCE_APID, K_MAX_TLM_SIZE, 0> ScienceLayout;    // Sized by survey or burst length
+typedef TlmLayout<K_LINK_APID, K_LINK_SIZE, K_LINK_SIZE - 15> LinkLayout;
+typedef TlmLayout<K_DIAG_APID, K_DIAG_SIZE, K_DIAG_SIZE - 15> DiagLayout;
+
+// Checksum of bytes 4-7 (alive/power/length and APID) for each heartbeat and power state
+typedef struct TlmPrefix {
+    uint16_t crc[K_TLM_FLAG_STATES];
+} TlmPrefix;
+
+typedef struct EchoPrefix {
+    TlmPrefix by_args[K_ECHO_MAX_ARGS + 1];
+} EchoPrefix;
+
+template <class CHECKSUM>
+constexpr TlmPrefix tlmPrefix(uint16_t apid, uint16_t pack_size) {
+    TlmPrefix prefix = {};
+    uint16_t data_len = pack_size - K_INS_DATA_LEN_OFFSET;
+    for(uint8_t flags = 0; flags < K_TLM_FLAG_STATES; flags++) {
+        uint8_t alive = ((flags & 0x01) ? 0x80 : 0x00) | ((flags & 0x02) ? 0x40 : 0x00);
+        uint16_t check = CHECKSUM::step(CHECKSUM::seed, alive | ((data_len >> 8) & 0xFF));
+        check = CHECKSUM::step(check, data_len & 0xFF);
+        check = CHECKSUM::step(check, 0x08 | ((apid >> 8) & 0x07));
+        prefix.crc[flags] = CHECKSUM::step(check, apid & 0xFF);
+    }
+    return prefix;
+}
 
 /********************
 Enums
@@ -53,24 +200,336 @@ typedef enum UPDATE_STATE {
    TOGGLE_POWER = 4,
 } UPDATE_STATE;
 
+// Command turnaround, each measured from the end of the one before
+typedef enum E_LAT_STAGE {
+   LAT_RX = 0,                                     // Sync found to ITF CRC verified
+   LAT_DISPATCH = 1,                               // CRC verified to processCommands(), waiting in its buffer
+   LAT_EXECUTE = 2,                                // processCommands() to echo queued by sendData()
+   LAT_DRAIN = 3,                                  // Echo queued to its last byte written to the UART
+   LAT_TURNAROUND = 4,                             // Sync found to the echo's last byte written
+   LAT_STAGES = 5,
+} LAT_STAGE;
+
 typedef enum ALARM_STATE {
    ITF_LENGTH = 0,
    ITF_CHECKSUM = 1,
    CCSDS_FORMAT = 2,
    CCSDS_APID = 3,
    CCSDS_LENGTH = 4,
+   ALARM_TYPES = 5,
 } ALARM_STATE;
 
+// How alarm() reaches the TX queue, the auxiliary byte of each packet is the occurrences it stands for
+typedef enum ALARM_MODE {
+   ALARM_IMMEDIATE = 0,                            // A packet per event while the token bucket has tokens
+   ALARM_COALESCE = 1,                             // Counts per type, sent at the end of each ITF or window
+} ALARM_MODE;
+
+/********************
+Structures
+*********************/
+// Command packet inside the received ITF frame
+typedef struct S_CMD_DESC {
+    uint16_t offset;                               // Opcode index in its frame, arguments start 2 after
+    uint16_t length;                               // Argument count
+    uint8_t opcode;
+    uint8_t macro;
+} CMD_DESC;
+
+// ITF and its commands, used in place until processCommands() is done with them
+typedef struct S_RX_BUFFER {
+    uint8_t frame[K_MAX_PACKET_SIZE + K_ECHO_MAX_ARGS];   // Slack so echo() of a short command stays in bounds
+    CMD_DESC cmd_desc[K_MAX_CMDS];
+    uint8_t command_num;                           // Valid descriptors
+    uint32_t sync_us;                              // Sync found
+    uint32_t crc_us;                               // CRC verified
+} RX_BUFFER;
+
+// Static footprint of one instrument in bytes, every buffer is a member so nothing comes from the heap
+typedef struct S_RAM_REPORT {
+    uint32_t rx;                                   // ITF buffers and command descriptors
+    uint32_t tx;                                   // TLM queue
+    uint32_t science;                              // Science frames
+    uint32_t other;                                // Histograms, prefixes, state and counters
+    uint32_t port;                                 // Memory the SerialPort adds to the UART
+    uint32_t total;                                // Driver and port
+} RAM_REPORT;
+
+// Fixed period task on micros(), deadlines advance by the period so the cadence never drifts
+typedef struct S_SCHEDULE {
+    uint32_t period_us;                            // 0 stops it
+    uint32_t next_us;                              // Deadline of the next tick
+    uint32_t late_us;                              // How late the last tick ran
+    uint32_t late_max_us;                          // Worst since the last scheduleStart()
+    uint64_t late_sum_us;
+    uint32_t ticks;
+    uint32_t missed;                               // Whole periods that passed without a tick
+} SCHEDULE;
+
+// Latency histogram, bucket 0 is under 1 us and bucket b is 2^(b-1) to 2^b us, the last one open ended
+typedef struct S_LAT_HIST {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[K_LAT_BUCKETS];
+} LAT_HIST;
+
+// Telemetry APIDs of one instrument
+typedef struct S_INSTRUMENT_APIDS {
+    uint16_t echo;
+    uint16_t alarm;
+    uint16_t link;
+    uint16_t status;
+    uint16_t science;
+    uint16_t diag;
+} INSTRUMENT_APIDS;
+
+// Default set moved to another base, keeping each APID's offset. Bases up to 0x7F0 keep them in 11 bits
+constexpr INSTRUMENT_APIDS instrumentApids(uint16_t base) {
+    return {(uint16_t)(base + K_ECHO_APID - K_APID_BASE), (uint16_t)(base + K_ALARM_APID - K_APID_BASE),
+            (uint16_t)(base + K_LINK_APID - K_APID_BASE), (uint16_t)(base + K_STATUS_APID - K_APID_BASE),
+            (uint16_t)(base + K_SCIENCE_APID - K_APID_BASE), (uint16_t)(base + K_DIAG_APID - K_APID_BASE)};
+}
+constexpr INSTRUMENT_APIDS K_DEFAULT_APIDS = instrumentApids(K_APID_BASE);
+
 /********************
 Functions
 *********************/
-void getData(void);
-void buildCRC(void);
-uint16_t crc(uint16_t checksum, uint8_t data);
-void reset();
-void instrumentUpdate(UPDATE_STATE updade_arg);
-void processCommands(void);
-void sendData(int pack_size);
-void echo(uint16_t arg_count, uint16_t cmd_location_head, uint8_t command_result);
-void status();
-void alarm(ALARM_STATE alarm_type);
\ No newline at end of file
+void scheduleStart(SCHEDULE &sched, uint32_t period_us, uint32_t now_us);
+uint32_t scheduleDue(SCHEDULE &sched, uint32_t now_us);
+
+/********************
+Classes
+*********************/
+// One simulated instrument on one UART with its own FSM, queues and schedules, so loop() can serve several
+// round-robin. Construct at file scope, it holds two science frames. CHECKSUM is a policy from checksum.h,
+// instrument_driver.cpp instantiates the ones that are built.
+template <class CHECKSUM>
+class InstrumentDriver {
+public:
+    InstrumentDriver(SerialPort &port, const INSTRUMENT_APIDS &apids = K_DEFAULT_APIDS);
+
+    // loop()
+    void service(void);
+    void getData(void);
+    void statusBegin(void);
+    void statusService(void);
+    void loopTimer(void);
+    void txDrain(void);
+    void linkBegin(uint32_t baud, LINK_FORMAT format);
+    void linkService(void);
+
+    // Capture of RX chunks and TX frames, NULL stops it
+    void captureAttach(CaptureHeader *log, uint8_t source);
+
+    // Counters and settings
+    SerialPort& serialPort(void) { return port; }
+    const INSTRUMENT_APIDS& apids(void) const { return tlm_apids; }
+    const SCHEDULE& statusSchedule(void);
+    const LAT_HIST& latencyHist(LAT_STAGE stage);
+    void latencyReset(void);
+#ifndef ARDUINO
+    void latencyDump(void);
+#endif
+    uint8_t txQueueDepth(void);
+    uint8_t txQueueHighWater(void);
+    uint32_t txQueueDropped(void);
+    uint32_t txBytesWritten(void);
+    uint16_t scienceSize(void);
+    uint32_t scienceFramesSent(void);
+    uint32_t linkBaud(void);
+    LINK_FORMAT linkFormat(void);
+    uint32_t linkLineRate(void);
+    float linkUtilisation(uint32_t bytes, uint32_t elapsed_us);
+    static RAM_REPORT ramReport(void);
+
+private:
+    // Executes one command, returns the command_result for its echo
+    typedef uint8_t (InstrumentDriver::*CMD_HANDLER)(const CMD_DESC &cmd);
+
+    // Handler for every opcode, filled in by the compiler
+    typedef struct CmdTable {
+        CMD_HANDLER handler[K_CMD_OPCODES];
+    } CmdTable;
+
+    static constexpr CmdTable cmdBuildTable(void);
+    static const CmdTable CMD_TABLE;
+
+    void parseByte(uint8_t rx_byte);
+    size_t syncScan(const uint8_t *chunk, size_t start, size_t len);
+    size_t frameFast(const uint8_t *tail, size_t tail_len, int &available);
+    bool frameLoad(void);
+    void frameEnd(void);
+    void reset();
+    void instrumentUpdate(UPDATE_STATE updade_arg);
+    void processCommands(void);
+    uint8_t cmdEcho(const CMD_DESC &cmd);
+    uint8_t cmdSurvey(const CMD_DESC &cmd);
+    uint8_t cmdBurst(const CMD_DESC &cmd);
+    uint8_t cmdLink(const CMD_DESC &cmd);
+    uint8_t cmdLinkTest(const CMD_DESC &cmd);
+    uint8_t cmdEchoMode(const CMD_DESC &cmd);
+    uint8_t cmdStatusRate(const CMD_DESC &cmd);
+    uint8_t cmdAlarmMode(const CMD_DESC &cmd);
+    void latencyAdd(LAT_STAGE stage, uint32_t latency_us);
+    uint8_t* txAcquire(void);
+    void sendData(int pack_size);
+    void scienceBuild(void);
+    bool scienceStart(void);
+    void echo(const CMD_DESC &cmd, uint8_t command_result);
+    int echoPacket(uint8_t *ccsds, const CMD_DESC &cmd, uint8_t command_result);
+    void echoBatchSend(uint8_t *tlm_packet, int pack_size);
+    uint8_t* tlmBegin(const uint8_t *tlm_template, uint8_t template_size, int pack_size, uint16_t apid);
+    void tlmHeader(uint8_t *tlm_packet, int pack_size);
+    void tlmSend(uint8_t *tlm_packet, int pack_size, int crc_offset, const TlmPrefix &prefix);
+    void status();
+    void alarm(ALARM_STATE alarm_type);
+    bool alarmSend(ALARM_STATE alarm_type);
+    void alarmFlush(void);
+    void alarmService(void);
+    bool alarmToken(void);
+    void linkTestReport(void);
+    void latencyReport(void);
+
+    // Transport and telemetry identity
+    SerialPort &port;
+    INSTRUMENT_APIDS tlm_apids;
+    CaptureHeader *capture_log = NULL;
+    uint8_t capture_source = 0;                    // Tags this instrument's records
+
+    // Checksum of the constant prefix of each packet for this instrument's APIDs, only the tail is hashed at runtime
+    TlmPrefix status_prefix;
+    TlmPrefix alarm_prefix;
+    TlmPrefix link_prefix;
+    TlmPrefix diag_prefix;
+    EchoPrefix echo_prefix;
+
+    // Instrument Values
+    uint8_t i_heartbeat = 0x80;
+    uint16_t i_sequence_count = 0;
+    uint8_t i_power = 0x00;
+    uint32_t i_time = 0;
+
+    // Scheduler
+    SCHEDULE met_schedule = {K_MET_PERIOD_US, K_MET_PERIOD_US, 0, 0, 0, 0, 0};
+    SCHEDULE status_schedule = {K_STATUS_PERIOD_US, K_STATUS_PERIOD_US, 0, 0, 0, 0, 0};
+    SCHEDULE diag_schedule = {K_DIAG_PERIOD_US, K_DIAG_PERIOD_US, 0, 0, 0, 0, 0};
+
+    // Latency, timestamps from micros() for the ITF being handled
+    LAT_HIST lat_hist[LAT_STAGES] = {};
+    uint32_t lat_sync_us = 0;                      // Sync found for the ITF being read
+    uint32_t lat_cmd_sync_us = 0;                  // Sync found for the ITF whose commands are running
+    uint32_t lat_proc_us = 0;                      // processCommands() entered
+    uint8_t lat_echo_next = 0;                     // Next sendData() is an echo to time
+
+    // Survey State Info
+    uint8_t g_surv_enabled = 0;
+    uint16_t g_surv_len = K_MAX_TLM_SIZE;
+
+    // Burst State Info
+    uint8_t g_burst_enabled = 0;
+    uint16_t g_burst_len = 0;
+
+    // Echo State Info
+    uint8_t g_echo_batch = 0;                      // All echoes of an ITF in one TLM frame
+
+    // Link
+    uint32_t link_baud = INSTRUMENT_BAUD;
+    LINK_FORMAT link_format = INSTRUMENT_FORMAT;
+    uint8_t link_pending = 0;                      // Commanded rate waiting for TX to finish
+    uint32_t link_pending_baud = 0;
+    LINK_FORMAT link_pending_format = INSTRUMENT_FORMAT;
+    uint32_t rx_bytes = 0;                         // Bytes read from the UART
+    uint32_t rx_frames = 0;                        // ITF frames that passed CRC
+    uint32_t rx_crc_failures = 0;                  // ITF frames that failed CRC
+
+    // Health, reported in status
+    uint16_t alarm_counts[ALARM_TYPES] = {};       // Alarms raised by type
+    uint32_t cmd_executed = 0;                     // Commands run through CMD_TABLE
+    uint32_t loop_last_us = 0;                     // Start of the last loop() pass
+    uint32_t loop_max_us = 0;                      // Longest pass since the last status
+
+    // Alarms, occurrences by type not yet in a packet
+    ALARM_MODE alarm_mode = INSTRUMENT_ALARM_MODE;
+    uint32_t alarm_pending[ALARM_TYPES] = {};      // Over K_ALARM_COUNT_MAX goes out in more than one packet
+    SCHEDULE alarm_schedule = {0, 0, 0, 0, 0, 0, 0};   // Coalescing window, 0 sends at the end of each ITF
+    uint32_t alarm_token_us = K_ALARM_TOKEN_US;    // Immediate refill period, 0 uncapped
+    uint8_t alarm_tokens = K_ALARM_BURST;
+    uint32_t alarm_refill_us = 0;                  // Bucket counted up to here
+    uint8_t alarm_mode_pending = 0;                // Commanded mode waiting for the ITF's echoes to be queued
+    ALARM_MODE alarm_pending_mode = INSTRUMENT_ALARM_MODE;
+    uint32_t alarm_pending_period_us = 0;
+
+    // Link self-test, counters at the start of the window
+    uint8_t link_test_running = 0;
+    uint32_t link_test_start_us = 0;
+    uint32_t link_test_us = 0;
+    uint32_t link_test_rx_bytes = 0;
+    uint32_t link_test_rx_frames = 0;
+    uint32_t link_test_crc_failures = 0;
+    uint32_t link_test_overruns = 0;
+    uint32_t link_test_tx_bytes = 0;
+    uint32_t link_test_tx_dropped = 0;
+
+    // Flags
+    uint8_t flag_time_recieved = 0;                // Successful time packet recieved
+    uint8_t flag_time_pending = 0;                 // Time from a verified ITF waiting for the next MET tick
+    uint8_t flag_packet_error = 0;                 // Error during recieving CCSDS
+    uint8_t flag_sync_found = 0;                   // ITF frame found
+    uint8_t flag_end_reached = 0;                  // ITF frame done
+
+    // Counters
+    REC_STATE state = E_REC_IDLE;                  // FSM for getData()
+    REC_STATE next_state = E_REC_IDLE;             // FSM for getData()
+    uint16_t g_read_count = 0;                     // Total reads of ITF
+    uint8_t g_idle_count = 0;                      // Bytes idled in CMD_START
+    uint8_t g_command_num = 0;                     // Command packets recieved in ITF
+    uint16_t g_cmd_read_count = 0;                 // Reads of command CCSDS
+
+    // Reads
+    uint8_t new_byte = 0x00;                       // Most recent byte read
+    uint32_t g_four_bytes = 0x00000000;            // Last 4 bytes read
+    uint16_t g_two_bytes = 0x0000;                 // Last 2 bytes read
+    uint16_t g_data_len = 0;                       // ITF frame length
+    uint32_t g_time_rx = 0;                        // Time packet of the ITF being read
+    uint32_t g_time_next = 0;                      // The time of the next 1pps
+    uint16_t g_cmd_length = 0;                     // Length of command
+    // ITFs, the FSM fills one while the last verified one waits in the other for processCommands()
+    RX_BUFFER rx_buffs[K_RX_BUFFS] = {};
+    uint8_t rx_fill = 0;                           // Buffer the FSM is filling
+    uint8_t rx_ready = 0;                          // Other buffer holds commands to run
+    uint8_t *rx_frame = rx_buffs[0].frame;         // ITF being read
+    CMD_DESC *cmd_desc = rx_buffs[0].cmd_desc;     // Where each command sits in rx_frame
+    const uint8_t *cmd_frame = rx_buffs[0].frame;  // ITF whose commands are running
+
+    // Output
+    uint8_t tx_slots[K_TX_SLOTS][K_TX_SLOT_SIZE] = {};   // Queued TLM frames
+    uint16_t tx_slot_len[K_TX_SLOTS] = {};         // Size of each queued frame
+    uint8_t tx_head = 0;                           // Slot being sent
+    uint8_t tx_count = 0;                          // Slots queued
+    uint16_t tx_sent = 0;                          // Bytes of head slot already written
+    uint8_t tx_high_water = 0;                     // Most slots ever queued
+    uint32_t tx_dropped = 0;                       // Frames dropped on a full queue
+    uint32_t tx_bytes = 0;                         // Bytes handed to the UART
+    uint8_t tx_slot_timed[K_TX_SLOTS] = {};        // Slot holds an echo being timed
+    uint32_t tx_slot_sync_us[K_TX_SLOTS] = {};     // Sync of the ITF it answers
+    uint32_t tx_slot_queued_us[K_TX_SLOTS] = {};   // When sendData() queued it
+
+    // Science
+    // Frame on the wire and the next one behind it
+    uint8_t sci_buff[K_SCIENCE_BUFFS][K_MAX_TLM_SIZE] = {};
+    uint16_t sci_len[K_SCIENCE_BUFFS] = {};        // Size of each built frame
+    uint8_t sci_active = 0;                        // Buffer being sent
+    uint8_t sci_next = 0;                          // Buffer the next frame is built in
+    uint8_t sci_ready = 0;                         // Next frame is built
+    uint8_t sci_sending = 0;                       // Active frame is part way out
+    uint16_t sci_sent = 0;                         // Bytes of active frame already written
+    uint16_t sci_sequence_count = 0;               // Science keeps its own CCSDS sequence
+    uint32_t sci_frame_count = 0;                  // Frames built, seeds the payload ramp
+    uint32_t sci_frames_sent = 0;                  // Frames fully written
+};
+
+// The driver the sketch and benches run, -DINSTRUMENT_CHECKSUM= picks the policy
+typedef InstrumentDriver<INSTRUMENT_CHECKSUM> InstrumentSim;
+
+#endif
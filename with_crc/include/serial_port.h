@@ -0,0 +1,233 @@
+/* serial_port.h
+Author:  Emma Stensland
+Date:    October 2026
+-----------
+Description
+-----------
+Serial transport used by the instrument driver. The backend is picked at compile time so the driver
+pays nothing for the abstraction:
+    ARDUINO - forwards to a Teensy HardwareSerial, one port per simulated instrument
+    host    - in-memory loopback, the harness feeds RX bytes and inspects what was transmitted. setLine()
+              paces TX like a UART on the virtual clock so line utilisation can be measured */
+
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+/********************
+Includes
+*********************/
+#include "instrument.h"
+
+/********************
+Enums
+*********************/
+typedef enum E_LINK_FORMAT {
+   LINK_8N1 = 0,
+   LINK_8O1 = 1,
+   LINK_8E1 = 2,
+   LINK_8N2 = 3,
+   LINK_FORMATS = 4,
+} LINK_FORMAT;
+
+/********************
+Constants
+*********************/
+const uint8_t K_LINK_FRAME_BITS[LINK_FORMATS] = {10, 11, 11, 11};   // Start, data, parity, stop bits per byte
+const uint32_t K_LINK_MIN_BAUD = 1200;
+const uint32_t K_LINK_MAX_BAUD = 6000000;          // LPUART on the 24 MHz clock, 4x oversampling
+const uint16_t K_UART_RX_BUFF = 64;                // Teensy 4 Serial2 buffers
+const uint16_t K_UART_TX_BUFF = 40;
+const uint16_t K_UART_RX_EXTRA = 4096;             // Added so Mbaud RX survives a science frame build
+const uint16_t K_UART_TX_EXTRA = 1024;
+#ifndef ARDUINO
+const uint32_t K_HOST_RX_SIZE = 65536;            // Loopback RX ring, power of two
+const uint32_t K_HOST_TX_SIZE = 65536;            // Loopback TX capture
+#endif
+
+/********************
+Classes
+*********************/
+#ifdef ARDUINO
+class SerialPort {
+public:
+    // lpuart is the peripheral behind uart, e.g. IMXRT_LPUART4 for Serial2 on the Teensy 4.1
+    SerialPort(HardwareSerial &uart, IMXRT_LPUART_t &lpuart) : uart(uart), lpuart(lpuart) {}
+
+    void begin(uint32_t baud, LINK_FORMAT format) {
+        static const uint16_t formats[LINK_FORMATS] = {SERIAL_8N1, SERIAL_8O1, SERIAL_8E1, SERIAL_8N2};
+        uart.addMemoryForRead(rx_extra, sizeof(rx_extra));
+        uart.addMemoryForWrite(tx_extra, sizeof(tx_extra));
+        uart.begin(baud, formats[format]);
+    }
+
+    // Counts the LPUART overrun flag and clears it, one count per overrun event however many bytes it lost.
+    // The other write-1-to-clear flags are masked so the ISR still sees them
+    int available() {
+        uint32_t stat = lpuart.STAT;
+        if(stat & LPUART_STAT_OR) {
+            lpuart.STAT = (stat & ~(LPUART_STAT_LBKDIF | LPUART_STAT_RXEDGIF | LPUART_STAT_IDLE | LPUART_STAT_NF |
+                                    LPUART_STAT_FE | LPUART_STAT_PF | LPUART_STAT_MA1F | LPUART_STAT_MA2F)) |
+                          LPUART_STAT_OR;
+            rx_overruns++;
+        }
+        return uart.available();
+    }
+    uint32_t rxOverruns() const { return rx_overruns; }
+
+    int read() { return uart.read(); }
+    // Callers only ask for what available() reported, so Stream's timeout never applies
+    size_t readBytes(uint8_t *data, size_t len) { return uart.readBytes((char *)data, len); }
+    int availableForWrite() { return uart.availableForWrite(); }
+    size_t write(const uint8_t *data, size_t len) { return uart.write(data, len); }
+    void flush() { uart.flush(); }
+
+private:
+    HardwareSerial &uart;
+    IMXRT_LPUART_t &lpuart;
+    uint8_t rx_extra[K_UART_RX_EXTRA];
+    uint8_t tx_extra[K_UART_TX_EXTRA];
+    uint32_t rx_overruns = 0;
+};
+#else
+class SerialPort {
+public:
+    // Driver side
+    void begin(uint32_t baud, LINK_FORMAT format) {
+        lineUpdate();
+        line_rate = baud / K_LINK_FRAME_BITS[format];
+    }
+
+    int available() { return (int)(rx_head - rx_tail); }
+
+    int read() {
+        if(rx_head == rx_tail) {
+            return -1;
+        }
+        return rx_buff[rx_tail++ & (K_HOST_RX_SIZE - 1)];
+    }
+
+    // Copies up to len bytes, never waits
+    size_t readBytes(uint8_t *data, size_t len) {
+        size_t count = rx_head - rx_tail;
+        if(len > count) {
+            len = count;
+        }
+        size_t start = rx_tail & (K_HOST_RX_SIZE - 1);
+        size_t first = K_HOST_RX_SIZE - start;
+        if(first > len) {
+            first = len;
+        }
+        memcpy(data, &rx_buff[start], first);
+        memcpy(data + first, rx_buff, len - first);
+        rx_tail += len;
+        return len;
+    }
+
+    // Room left in the TX capture, the harness frees it with clearTx(). When paced, also the room left in the
+    // UART buffer
+    int availableForWrite() {
+        size_t space = K_HOST_TX_SIZE - tx_len;
+        if(line_fifo != 0) {
+            lineUpdate();
+            if(space > line_fifo - line_pending) {
+                space = line_fifo - line_pending;
+            }
+        }
+        return (int)space;
+    }
+
+    size_t write(const uint8_t *data, size_t len) {
+        tx_total += len;
+        if(line_fifo != 0) {
+            line_pending += len;
+        }
+        // Keep what fits for the harness to inspect, count the rest
+        size_t keep = len;
+        if(keep > K_HOST_TX_SIZE - tx_len) {
+            keep = K_HOST_TX_SIZE - tx_len;
+            tx_dropped += len - keep;
+        }
+        memcpy(&tx_buff[tx_len], data, keep);
+        tx_len += keep;
+        return len;
+    }
+
+    void flush() {}
+
+    uint32_t rxOverruns() const { return rx_overruns; }
+
+    // Harness side, bytes that don't fit the RX buffer are lost like a UART overrun
+    size_t feed(const uint8_t *data, size_t len) {
+        size_t space = rx_capacity - (rx_head - rx_tail);
+        if(len > space) {
+            rx_overruns += len - space;
+            len = space;
+        }
+        for(size_t i = 0; i < len; i++) {
+            rx_buff[rx_head++ & (K_HOST_RX_SIZE - 1)] = data[i];
+        }
+        return len;
+    }
+
+    const uint8_t *txData() const { return tx_buff; }
+    size_t txSize() const { return tx_len; }
+    uint64_t txTotal() const { return tx_total; }
+    uint64_t txDropped() const { return tx_dropped; }
+    void clearTx() { tx_len = 0; }
+
+    // Sizes the RX buffer, up to K_HOST_RX_SIZE
+    void setRxBuffer(uint32_t size) {
+        rx_capacity = size < K_HOST_RX_SIZE ? size : K_HOST_RX_SIZE;
+    }
+
+    // Sends at the rate given to begin() out of a UART buffer of fifo_size bytes, 0 turns pacing off
+    void setLine(uint32_t fifo_size) {
+        line_fifo = fifo_size;
+        line_pending = 0;
+        line_credit = 0;
+        line_last_us = micros();
+    }
+
+    // Bytes that have left the paced line
+    uint64_t lineSent() {
+        lineUpdate();
+        return line_sent;
+    }
+
+private:
+    uint8_t rx_buff[K_HOST_RX_SIZE];
+    uint32_t rx_head = 0;
+    uint32_t rx_tail = 0;
+    uint32_t rx_capacity = K_HOST_RX_SIZE;
+    uint32_t rx_overruns = 0;
+    uint8_t tx_buff[K_HOST_TX_SIZE];
+    size_t tx_len = 0;
+    uint64_t tx_total = 0;
+    uint64_t tx_dropped = 0;
+    uint32_t line_rate = 0;                        // Bytes per second
+    uint32_t line_fifo = 0;
+    uint32_t line_pending = 0;                     // Written but not yet on the line
+    uint64_t line_credit = 0;                      // Byte-microseconds of line time not yet used
+    uint64_t line_sent = 0;
+    uint32_t line_last_us = 0;
+
+    void lineUpdate() {
+        uint32_t now_us = micros();
+        uint64_t credit = line_credit + (uint64_t)(now_us - line_last_us) * line_rate;
+        line_last_us = now_us;
+        uint64_t drained = credit / 1000000;
+        if(drained >= line_pending) {
+            // Line went idle, idle time can't be banked
+            line_sent += line_pending;
+            line_pending = 0;
+            line_credit = 0;
+        }else {
+            line_sent += drained;
+            line_pending -= drained;
+            line_credit = credit - drained * 1000000;
+        }
+    }
+};
+#endif
+
+#endif
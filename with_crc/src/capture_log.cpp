@@ -0,0 +1,228 @@
+/* capture_log.cpp
+Author: Emma Stensland
+Date:   October 2026
+-----------
+Description
+-----------
+Capture ring writer and reader, see capture_log.h for the layout
+NOTES: records occupy the ring from tail to head, wrapping once. A CAPTURE_WRAP record, or a gap too small
+for one, marks where the newest records jumped back to the start */
+
+/********************
+Includes
+*********************/
+#include "capture_log.h"
+#ifndef ARDUINO
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**********************************************************************************************************************
+* Function      : uint32_t captureRecordSize(uint16_t len)
+* Description   : Ring bytes taken by a record with len payload bytes
+* Arguments     : uint16_t len
+* Returns       : uint32_t
+**********************************************************************************************************************/
+static inline uint32_t captureRecordSize(uint16_t len) {
+    return (sizeof(CaptureRecord) + len + K_CAPTURE_ALIGN - 1) & ~(uint32_t)(K_CAPTURE_ALIGN - 1);
+}
+
+static inline uint8_t* captureArea(CaptureHeader *log) {
+    return (uint8_t *)log + log->header_size;
+}
+
+// A record can't start here, the next one is at the start of the ring
+static inline bool captureWraps(const uint8_t *area, uint32_t capacity, uint32_t offset) {
+    return capacity - offset < sizeof(CaptureRecord) ||
+           ((const CaptureRecord *)&area[offset])->direction == CAPTURE_WRAP;
+}
+
+/**********************************************************************************************************************
+* Function      : void captureEvict(CaptureHeader* log)
+* Description   : Drops the oldest record
+* Arguments     : CaptureHeader* log - at least one record in it
+* Returns       : none
+**********************************************************************************************************************/
+static void captureEvict(CaptureHeader *log) {
+    uint8_t *area = captureArea(log);
+    const CaptureRecord *oldest = (const CaptureRecord *)&area[log->tail];
+    log->tail += captureRecordSize(oldest->length);
+    log->count--;
+    log->overwritten++;
+
+    // Tail never rests on the wrap, so a wrap it finds later is always the one it should follow
+    if(log->count > 0 && captureWraps(area, log->capacity, log->tail)) {
+        log->tail = 0;
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : CaptureHeader* captureInit(void* memory, uint32_t size)
+* Description   : Lays an empty ring over memory
+* Arguments     : void* memory - K_CAPTURE_ALIGN aligned, uint32_t size - bytes including the header
+* Returns       : CaptureHeader* - NULL if size leaves no room for records
+**********************************************************************************************************************/
+CaptureHeader* captureInit(void *memory, uint32_t size) {
+    if(memory == NULL || size < sizeof(CaptureHeader) + 4 * sizeof(CaptureRecord)) {
+        return NULL;
+    }
+    CaptureHeader *log = (CaptureHeader *)memory;
+    memset(log, 0, sizeof(CaptureHeader));
+    log->magic = K_CAPTURE_MAGIC;
+    log->version = K_CAPTURE_VERSION;
+    log->header_size = sizeof(CaptureHeader);
+    log->capacity = (size - sizeof(CaptureHeader)) & ~(uint32_t)(K_CAPTURE_ALIGN - 1);
+    return log;
+}
+
+/**********************************************************************************************************************
+* Function      : void captureAppend(CaptureHeader* log, CAPTURE_DIR direction, uint8_t source, const uint8_t* data,
+*                                   uint16_t len)
+* Description   : Appends a record stamped with micros(), overwriting the oldest records to make room
+* Arguments     : CaptureHeader* log, CAPTURE_DIR direction, uint8_t source - instrument,
+*                 const uint8_t* data, uint16_t len - payload
+* Returns       : none
+* Remarks       : Payloads are cut to half the ring so one record never empties it
+**********************************************************************************************************************/
+void captureAppend(CaptureHeader *log, CAPTURE_DIR direction, uint8_t source, const uint8_t *data, uint16_t len) {
+    uint8_t *area = captureArea(log);
+    uint32_t max_len = log->capacity / 2 - sizeof(CaptureRecord);
+    if(len > max_len) {
+        len = max_len;
+    }
+    uint32_t need = captureRecordSize(len);
+    if(log->count == 0) {
+        log->tail = log->head;
+    }
+
+    // Doesn't fit before the end, free the end and mark the jump back to the start
+    if(log->head + need > log->capacity) {
+        while(log->count > 0 && log->tail >= log->head) {
+            captureEvict(log);
+        }
+        if(log->capacity - log->head >= sizeof(CaptureRecord)) {
+            CaptureRecord *wrap = (CaptureRecord *)&area[log->head];
+            wrap->time_us = micros();
+            wrap->length = 0;
+            wrap->direction = CAPTURE_WRAP;
+            wrap->source = source;
+        }
+        log->head = 0;
+        if(log->count == 0) {
+            log->tail = 0;
+        }
+    }
+
+    // Records from tail that start where this one goes
+    while(log->count > 0 && log->tail >= log->head && log->tail < log->head + need) {
+        captureEvict(log);
+    }
+    if(log->count == 0) {
+        log->tail = log->head;
+    }
+
+    CaptureRecord *record = (CaptureRecord *)&area[log->head];
+    record->time_us = micros();
+    record->length = len;
+    record->direction = direction;
+    record->source = source;
+    memcpy(record + 1, data, len);
+
+    log->head += need;
+    log->count++;
+    log->appended++;
+    log->payload_bytes += len;
+}
+
+/**********************************************************************************************************************
+* Function      : CaptureCursor captureBegin(const CaptureHeader* log)
+* Description   : Cursor at the oldest record
+* Arguments     : const CaptureHeader* log
+* Returns       : CaptureCursor
+**********************************************************************************************************************/
+CaptureCursor captureBegin(const CaptureHeader *log) {
+    CaptureCursor cursor;
+    cursor.area = (const uint8_t *)log + log->header_size;
+    cursor.capacity = log->capacity;
+    cursor.offset = log->tail;
+    cursor.left = log->count;
+    return cursor;
+}
+
+/**********************************************************************************************************************
+* Function      : bool captureNext(CaptureCursor& cursor, const CaptureRecord*& record, const uint8_t*& payload)
+* Description   : Steps to the next record, oldest first
+* Arguments     : CaptureCursor& cursor, const CaptureRecord*& record, const uint8_t*& payload - point into the ring
+* Returns       : bool - false once every record has been read
+**********************************************************************************************************************/
+bool captureNext(CaptureCursor &cursor, const CaptureRecord *&record, const uint8_t *&payload) {
+    if(cursor.left == 0) {
+        return false;
+    }
+    if(captureWraps(cursor.area, cursor.capacity, cursor.offset)) {
+        cursor.offset = 0;
+    }
+    record = (const CaptureRecord *)&cursor.area[cursor.offset];
+    payload = (const uint8_t *)(record + 1);
+    cursor.offset += captureRecordSize(record->length);
+    cursor.left--;
+    return true;
+}
+
+#ifndef ARDUINO
+/**********************************************************************************************************************
+* Function      : CaptureHeader* captureMapFile(const char* path, uint32_t size)
+* Description   : Creates a file of size bytes and lays an empty ring over a shared mapping of it
+* Arguments     : const char* path, uint32_t size
+* Returns       : CaptureHeader* - NULL on failure
+* Remarks       : The kernel writes the ring back to the file, it survives the process
+**********************************************************************************************************************/
+CaptureHeader* captureMapFile(const char *path, uint32_t size) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        return NULL;
+    }
+    if(ftruncate(fd, size) != 0) {
+        close(fd);
+        return NULL;
+    }
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED) {
+        return NULL;
+    }
+    return captureInit(memory, size);
+}
+
+/**********************************************************************************************************************
+* Function      : const CaptureHeader* captureOpenFile(const char* path)
+* Description   : Maps a capture file read only for captureBegin()
+* Arguments     : const char* path
+* Returns       : const CaptureHeader* - NULL if it can't be mapped or isn't a capture
+**********************************************************************************************************************/
+const CaptureHeader* captureOpenFile(const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CaptureHeader)) {
+        if(fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    void *memory = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED) {
+        return NULL;
+    }
+
+    const CaptureHeader *log = (const CaptureHeader *)memory;
+    if(log->magic != K_CAPTURE_MAGIC || log->version != K_CAPTURE_VERSION ||
+       (uint64_t)log->header_size + log->capacity > (uint64_t)st.st_size) {
+        munmap(memory, st.st_size);
+        return NULL;
+    }
+    return log;
+}
+#endif
@@ -0,0 +1,211 @@
+/* crc.cpp
+Author: Emma Stensland
+Date:   October 2026
+-----------
+Description
+-----------
+CRC-CCITT16 engines, all bit-exact with the original byte-wise table:
+    crc()               - one byte, used where the FSM only has a byte at a time
+    crcUpdateSlice4/8   - 4 or 8 bytes per step from CRC_LOOKUP.table[0..7]
+    crcUpdateClmul      - host only, folds 64 bytes per step with carry-less multiply (x86 PCLMULQDQ)
+    crcUpdate           - best engine for the build, use this for whole packets
+NOTES: CRC_LOOKUP is 4 KiB built by the compiler, nothing to set up at boot. On the Teensy slicing-by-8 is the
+fastest path (no carry-less multiply on the M7) */
+
+/********************
+Includes
+*********************/
+#include "crc.h"
+
+#if !defined(ARDUINO) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CRC_HAVE_CLMUL 1
+#endif
+
+/********************
+Global Variables
+*********************/
+// CRC-CCITT16 Lookup
+constexpr CrcTables CRC_LOOKUP PROGMEM = crcBuildTables();
+
+#ifdef CRC_HAVE_CLMUL
+// Folding constants x^n mod P
+constexpr uint16_t crc_fold_128 = crcXPow(128);
+constexpr uint16_t crc_fold_192 = crcXPow(192);
+constexpr uint16_t crc_fold_512 = crcXPow(512);
+constexpr uint16_t crc_fold_576 = crcXPow(576);
+#endif
+
+/**********************************************************************************************************************
+* Function      : uint16_t crc(uint_16_t)
+* Description   : Calculates the checksum for a given byte
+* Arguments     : uint816_t checksum, uint8_t data
+* Returns       : uint16_t
+* Remarks       : none
+**********************************************************************************************************************/
+uint16_t crc(uint16_t checksum, uint8_t data) {
+    // Shift new data into current checksum
+    uint8_t lookup = ((checksum >> 8) ^ data) & 0xFF;
+
+    // XOR the crc value with the shifted checksum
+    checksum = (checksum << 8) ^ CRC_LOOKUP.table[0][lookup];
+
+   // Return the remainder of dividing data with polynomial
+   return checksum;
+}
+
+/**********************************************************************************************************************
+* Function      : uint16_t crcUpdateBytewise(uint16_t checksum, const uint8_t* data, size_t len)
+* Description   : Reference engine, one table lookup per byte
+* Arguments     : uint16_t checksum - running CRC (CRC_SEED to start), const uint8_t* data, size_t len
+* Returns       : uint16_t
+**********************************************************************************************************************/
+uint16_t crcUpdateBytewise(uint16_t checksum, const uint8_t *data, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        checksum = crc(checksum, data[i]);
+    }
+    return checksum;
+}
+
+/**********************************************************************************************************************
+* Function      : uint16_t crcUpdateSlice4(uint16_t checksum, const uint8_t* data, size_t len)
+* Description   : Slicing-by-4, four independent lookups per 4 bytes
+* Arguments     : uint16_t checksum - running CRC (CRC_SEED to start), const uint8_t* data, size_t len
+* Returns       : uint16_t
+**********************************************************************************************************************/
+uint16_t crcUpdateSlice4(uint16_t checksum, const uint8_t *data, size_t len) {
+    while(len >= 4) {
+        // First two bytes absorb the current checksum, the rest only need advancing
+        checksum = CRC_LOOKUP.table[3][(checksum >> 8) ^ data[0]] ^
+                   CRC_LOOKUP.table[2][(checksum & 0xFF) ^ data[1]] ^
+                   CRC_LOOKUP.table[1][data[2]] ^
+                   CRC_LOOKUP.table[0][data[3]];
+        data += 4;
+        len -= 4;
+    }
+    return crcUpdateBytewise(checksum, data, len);
+}
+
+/**********************************************************************************************************************
+* Function      : uint16_t crcUpdateSlice8(uint16_t checksum, const uint8_t* data, size_t len)
+* Description   : Slicing-by-8, eight independent lookups per 8 bytes
+* Arguments     : uint16_t checksum - running CRC (CRC_SEED to start), const uint8_t* data, size_t len
+* Returns       : uint16_t
+**********************************************************************************************************************/
+uint16_t crcUpdateSlice8(uint16_t checksum, const uint8_t *data, size_t len) {
+    while(len >= 8) {
+        checksum = CRC_LOOKUP.table[7][(checksum >> 8) ^ data[0]] ^
+                   CRC_LOOKUP.table[6][(checksum & 0xFF) ^ data[1]] ^
+                   CRC_LOOKUP.table[5][data[2]] ^
+                   CRC_LOOKUP.table[4][data[3]] ^
+                   CRC_LOOKUP.table[3][data[4]] ^
+                   CRC_LOOKUP.table[2][data[5]] ^
+                   CRC_LOOKUP.table[1][data[6]] ^
+                   CRC_LOOKUP.table[0][data[7]];
+        data += 8;
+        len -= 8;
+    }
+    return crcUpdateSlice4(checksum, data, len);
+}
+
+#ifdef CRC_HAVE_CLMUL
+/**********************************************************************************************************************
+* Function      : bool crcHasClmul(void)
+* Description   : Checks the host CPU for carry-less multiply and byte shuffle
+* Arguments     : none
+* Returns       : bool
+**********************************************************************************************************************/
+bool crcHasClmul(void) {
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+// Loads 16 bytes so bit 127 is the first bit on the wire
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i crcLoad(const uint8_t *data, __m128i swap) {
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), swap);
+}
+
+// acc * x^n + next, with k holding x^(n+64) mod P high and x^n mod P low
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i crcFold(__m128i acc, __m128i k, __m128i next) {
+    __m128i hi = _mm_clmulepi64_si128(acc, k, 0x11);
+    __m128i lo = _mm_clmulepi64_si128(acc, k, 0x00);
+    return _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+}
+
+/**********************************************************************************************************************
+* Function      : uint16_t crcUpdateClmul(uint16_t checksum, const uint8_t* data, size_t len)
+* Description   : Folds the message down 64 bytes at a time with carry-less multiply, then finishes with the tables
+* Arguments     : uint16_t checksum - running CRC (CRC_SEED to start), const uint8_t* data, size_t len
+* Returns       : uint16_t
+* Remarks       : Seeding is done by XORing the checksum into the first two message bytes. Four lanes are folded
+*                 by 512 bits to hide multiply latency, then merged by 128 bits. The folded 128 bit remainder is
+*                 congruent to the message so far, so the tables finish it with a zero seed.
+**********************************************************************************************************************/
+__attribute__((target("pclmul,ssse3")))
+uint16_t crcUpdateClmul(uint16_t checksum, const uint8_t *data, size_t len) {
+    if(len < 64) {
+        return crcUpdateSlice8(checksum, data, len);
+    }
+
+    const __m128i swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i k128 = _mm_set_epi64x(crc_fold_192, crc_fold_128);
+    const __m128i k512 = _mm_set_epi64x(crc_fold_576, crc_fold_512);
+
+    __m128i x0 = _mm_xor_si128(crcLoad(data, swap), _mm_set_epi64x((uint64_t)checksum << 48, 0));
+    __m128i x1 = crcLoad(data + 16, swap);
+    __m128i x2 = crcLoad(data + 32, swap);
+    __m128i x3 = crcLoad(data + 48, swap);
+    data += 64;
+    len -= 64;
+
+    while(len >= 64) {
+        x0 = crcFold(x0, k512, crcLoad(data, swap));
+        x1 = crcFold(x1, k512, crcLoad(data + 16, swap));
+        x2 = crcFold(x2, k512, crcLoad(data + 32, swap));
+        x3 = crcFold(x3, k512, crcLoad(data + 48, swap));
+        data += 64;
+        len -= 64;
+    }
+
+    // Merge lanes
+    __m128i x = crcFold(x0, k128, x1);
+    x = crcFold(x, k128, x2);
+    x = crcFold(x, k128, x3);
+
+    while(len >= 16) {
+        x = crcFold(x, k128, crcLoad(data, swap));
+        data += 16;
+        len -= 16;
+    }
+
+    uint8_t rem[16];
+    _mm_storeu_si128((__m128i *)rem, _mm_shuffle_epi8(x, swap));
+    checksum = crcUpdateSlice8(CRC_SEED_TABLE, rem, sizeof(rem));
+    return crcUpdateSlice8(checksum, data, len);
+}
+#elif !defined(ARDUINO)
+bool crcHasClmul(void) {
+    return false;
+}
+
+uint16_t crcUpdateClmul(uint16_t checksum, const uint8_t *data, size_t len) {
+    return crcUpdateSlice8(checksum, data, len);
+}
+#endif
+
+/**********************************************************************************************************************
+* Function      : uint16_t crcUpdate(uint16_t checksum, const uint8_t* data, size_t len)
+* Description   : Runs the CRC over a block using the fastest engine available
+* Arguments     : uint16_t checksum - running CRC (CRC_SEED to start), const uint8_t* data, size_t len
+* Returns       : uint16_t
+**********************************************************************************************************************/
+uint16_t crcUpdate(uint16_t checksum, const uint8_t *data, size_t len) {
+#ifdef CRC_HAVE_CLMUL
+    static const bool crc_clmul = crcHasClmul();
+    if(crc_clmul && len >= 64) {
+        return crcUpdateClmul(checksum, data, len);
+    }
+#endif
+    return crcUpdateSlice8(checksum, data, len);
+}
@@ -5,372 +5,678 @@ Date:   23 December 2024
 Description
 -----------
 Functions for operating instrument simulator on a Teensy 4.1 
-NOTES: intended to send 1pps status and echo any commands sent, all in individual frames */
+NOTES: intended to send 1pps status and echo any commands sent, each echo in its own frame unless batch echo mode
+puts the echoes of one ITF in a single frame */
 
 /********************
 Includes
 *********************/
 #include "instrument_driver.h"
+#ifndef ARDUINO
+#include <stdio.h>
+#endif
 
 /********************
-Global Variables
+Constants
 *********************/
-// Instrument Values
-uint8_t i_heartbeat = 0x80;
-uint16_t i_sequence_count = 0;
-uint8_t i_power = 0x00;
-uint32_t i_time = 0;
-uint16_t i_status_send = 1;
-
-// CRC-CCITT16 Lookup
-uint16_t CRC_LOOKUP[256];
-
-// Flags
-uint8_t flag_time_recieved = 0;                    // Successful time packet recieved
-uint8_t flag_packet_error = 0;                     // Error during recieving CCSDS
-uint8_t flag_sync_found = 0;                       // ITF frame found
-uint8_t flag_end_reached = 0;                      // ITF frame done
-
-// Counters
-REC_STATE state = E_REC_IDLE;                      // FSM for getData()
-REC_STATE next_state = E_REC_IDLE;                 // FSM for getData()
-uint16_t g_read_count = 0;                         // Total reads of ITF
-uint8_t g_idle_count = 0;                          // Bytes idled in CMD_START
-uint8_t g_command_num = 0;                         // Command packets recieved in ITF * 2
-uint16_t g_cmd_read_count = 0;                     // Reads of command CCSDS
-uint16_t g_cmd_read_total = 0;                     // Reads since first command header
-uint16_t status_send_counter = 0;                  // 1pps packets read after status() called
-
-// Reads
-uint8_t new_byte = 0x00;                           // Most recent byte read
-uint32_t g_four_bytes = 0x00000000;                // Last 4 bytes read
-uint16_t g_two_bytes = 0x0000;                     // Last 2 bytes read
-uint16_t g_data_len = 0;                           // ITF frame length
-uint16_t crc_total = CRC_SEED;                     // CRC of ITF
-uint32_t g_time_next = 0;                          // The time of the next 1pps
-uint16_t g_cmd_length = 0;                         // Length of command
-uint8_t cmd_packets[K_MAX_CMD_SIZE * K_MAX_CMDS];  // All data from commands
-uint16_t cmd_location_info[K_MAX_CMDS * 2];        // Start and Arg Number of each command
-
-// Output
-uint8_t tlm_packet[K_MAX_TLM_SIZE];
+// Telemetry templates, everything that doesn't change between frames
+const uint8_t STATUS_TEMPLATE[StatusLayout::size] = {
+    0xFE, 0xFA, 0x30, 0xC8,                                // Sync
+    0x00, 0x00,                                            // Alive, Power Down, Spare, Length
+    StatusLayout::apid_high, StatusLayout::apid_low,       // Version, Type, Secondary, APID
+    0xC0, 0x00,                                            // Grouping, Sequence Count
+    0x00, StatusLayout::ccsds_length,                      // Length of packet after this byte
+};
+const uint8_t ECHO_TEMPLATE[K_ECHO_HEADER_SIZE] = {
+    0xFE, 0xFA, 0x30, 0xC8,                                // Sync
+    0x00, 0x00,                                            // Alive, Power Down, Spare, Length
+    EchoLayout::apid_high, EchoLayout::apid_low,           // Version, Type, Secondary, APID
+    0xC0, 0x00,                                            // Grouping, Sequence Count
+};
+const uint8_t ALARM_TEMPLATE[AlarmLayout::size] = {
+    0xFE, 0xFA, 0x30, 0xC8,                                // Sync
+    0x00, 0x00,                                            // Alive, Power Down, Spare, Length
+    AlarmLayout::apid_high, AlarmLayout::apid_low,         // Version, Type, Secondary, APID
+    0xC0, 0x00,                                            // Grouping, Sequence Count
+    0x00, AlarmLayout::ccsds_length,                       // Length of packet after this byte - 1
+    0x00, 0x00, 0x00, 0x00,                                // Time tag
+    0x01,                                                  // Alarm ID
+    0x01,                                                  // Type
+    0x00,                                                  // Value
+    0x00,                                                  // Auxillary, occurrences
+};
+const uint8_t LINK_TEMPLATE[K_TLM_HEADER_SIZE] = {
+    0xFE, 0xFA, 0x30, 0xC8,                                // Sync
+    0x00, 0x00,                                            // Alive, Power Down, Spare, Length
+    LinkLayout::apid_high, LinkLayout::apid_low,           // Version, Type, Secondary, APID
+    0xC0, 0x00,                                            // Grouping, Sequence Count
+    0x00, LinkLayout::ccsds_length,                        // Length of packet after this byte - 1
+};
+const uint8_t DIAG_TEMPLATE[K_TLM_HEADER_SIZE] = {
+    0xFE, 0xFA, 0x30, 0xC8,                                // Sync
+    0x00, 0x00,                                            // Alive, Power Down, Spare, Length
+    DiagLayout::apid_high, DiagLayout::apid_low,           // Version, Type, Secondary, APID
+    0xC0, 0x00,                                            // Grouping, Sequence Count
+    0x00, DiagLayout::ccsds_length,                        // Length of packet after this byte - 1
+};
+const uint8_t SCIENCE_TEMPLATE[K_TLM_SEQUENCE_OFFSET + 2] = {
+    0xFE, 0xFA, 0x30, 0xC8,                                // Sync
+    0x00, 0x00,                                            // Alive, Power Down, Spare, Length
+    ScienceLayout::apid_high, ScienceLayout::apid_low,     // Version, Type, Secondary, APID
+    0xC0, 0x00,                                            // Grouping, Sequence Count
+};
+
+static_assert(StatusLayout::ccsds_length <= 0xFF && AlarmLayout::ccsds_length <= 0xFF &&
+              LinkLayout::ccsds_length <= 0xFF && DiagLayout::ccsds_length <= 0xFF, "Templates hold one length byte");
+static_assert(K_ECHO_MAX_SIZE == EchoLayout::size, "Echo layout covers the most arguments");
+static_assert(K_ECHO_BATCH_MAX_SIZE <= K_TX_SLOT_SIZE, "Echo batch must fit a TX slot");
+// Upper bounds on the macros before they are narrowed, lower bounds on the constants they fit
+static_assert(INSTRUMENT_MAX_PACKET <= 0x1FFF + K_INS_DATA_LEN_OFFSET, "ITF length field is 13 bits");
+static_assert(INSTRUMENT_MAX_CMDS >= 1 && INSTRUMENT_MAX_CMDS + 6 <= 0xFF, "Commands and TX slots count in 8 bits");
+static_assert(INSTRUMENT_MAX_CMD_SIZE + 10 <= 0xFFFF, "Command length field is 16 bits");
+static_assert(K_MAX_PACKET_SIZE > K_MIN_PACKET_SIZE && K_MAX_CMD_SIZE >= K_MIN_CMD_SIZE,
+              "Capacity below the smallest ITF or command");
+static_assert(K_ECHO_BATCH_MAX_SIZE <= K_MAX_TLM_SIZE, "Echo batch of a full ITF must fit one TLM frame");
+static_assert(StatusLayout::size <= K_TX_SLOT_SIZE && AlarmLayout::size <= K_TX_SLOT_SIZE &&
+              EchoLayout::size <= K_TX_SLOT_SIZE && LinkLayout::size <= K_TX_SLOT_SIZE &&
+              DiagLayout::size <= K_TX_SLOT_SIZE,
+              "Housekeeping must fit a TX slot");
+
+// Echo prefixes for every argument count
+template <class CHECKSUM>
+constexpr EchoPrefix echoPrefix(uint16_t apid) {
+    EchoPrefix prefix = {};
+    for(uint8_t args = 0; args <= K_ECHO_MAX_ARGS; args++) {
+        prefix.by_args[args] = tlmPrefix<CHECKSUM>(apid, (args + K_ECHO_HEADER_SIZE + 5) & ~0x01);
+    }
+    return prefix;
+}
+
+// Opcode dispatch, one lookup per command
+template <class CHECKSUM>
+constexpr typename InstrumentDriver<CHECKSUM>::CmdTable InstrumentDriver<CHECKSUM>::cmdBuildTable(void) {
+    CmdTable table = {};
+    for(uint16_t opcode = 0; opcode < K_CMD_OPCODES; opcode++) {
+        table.handler[opcode] = &InstrumentDriver::cmdEcho;
+    }
+    table.handler[K_INS_CMD_SURVEY] = &InstrumentDriver::cmdSurvey;
+    table.handler[K_INS_CMD_BURST] = &InstrumentDriver::cmdBurst;
+    table.handler[K_INS_CMD_LINK] = &InstrumentDriver::cmdLink;
+    table.handler[K_INS_CMD_LINK_TEST] = &InstrumentDriver::cmdLinkTest;
+    table.handler[K_INS_CMD_ECHO_MODE] = &InstrumentDriver::cmdEchoMode;
+    table.handler[K_INS_CMD_STATUS_RATE] = &InstrumentDriver::cmdStatusRate;
+    table.handler[K_INS_CMD_ALARM_MODE] = &InstrumentDriver::cmdAlarmMode;
+    return table;
+}
+template <class CHECKSUM>
+const typename InstrumentDriver<CHECKSUM>::CmdTable InstrumentDriver<CHECKSUM>::CMD_TABLE = cmdBuildTable();
+
+/**********************************************************************************************************************
+* Function      : void tlmApid(uint8_t* field, uint16_t apid)
+* Description   : Writes the first two bytes of a CCSDS primary header
+* Arguments     : uint8_t* field, uint16_t apid - 11 bits
+* Returns       : none
+**********************************************************************************************************************/
+static inline void tlmApid(uint8_t *field, uint16_t apid) {
+    // Version, Type, Secondary, APID
+    field[0] = 0x08 | ((apid >> 8) & 0x07);
+    field[1] = apid & 0xFF;
+}
+
+/**********************************************************************************************************************
+* Function      : InstrumentDriver(SerialPort &port, const INSTRUMENT_APIDS &apids)
+* Description   : Binds an instrument to its UART and telemetry APIDs
+* Arguments     : SerialPort &port - must outlive the instrument, const INSTRUMENT_APIDS &apids
+* Returns       : none
+* Remarks       : Nothing touches the UART until linkBegin()
+**********************************************************************************************************************/
+template <class CHECKSUM>
+InstrumentDriver<CHECKSUM>::InstrumentDriver(SerialPort &port, const INSTRUMENT_APIDS &apids)
+    : port(port), tlm_apids(apids),
+      status_prefix(tlmPrefix<CHECKSUM>(apids.status, StatusLayout::size)),
+      alarm_prefix(tlmPrefix<CHECKSUM>(apids.alarm, AlarmLayout::size)),
+      link_prefix(tlmPrefix<CHECKSUM>(apids.link, LinkLayout::size)),
+      diag_prefix(tlmPrefix<CHECKSUM>(apids.diag, DiagLayout::size)),
+      echo_prefix(echoPrefix<CHECKSUM>(apids.echo)) {
+}
+
+/**********************************************************************************************************************
+* Function      : void service()
+* Description   : One loop() pass for this instrument
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::service(void) {
+    // Pass time for status
+    loopTimer();
+
+    // Continually check for data input
+    getData();
+
+    // Coalesced alarms whose window is up, immediate ones held for a token
+    alarmService();
+
+    // MET and status on their own clock
+    statusService();
+
+    // Feed queued telemetry to the UART
+    txDrain();
+
+    // Link changes and self-test
+    linkService();
+}
 
 /**********************************************************************************************************************
 * Function      : void getData(void)
 * Description   : Reads spacecraft data frame and loads commands for instrument
 * Arguments     : none
 * Returns       : none
-* Remarks       : State machine
-*                 E_REC_IDLE - wait for sync
-*                 E_REC_LENGTH - reads length of frame 
-*                 E_REC_TIME_START - waits for timestamp packet
-*                 E_REC_TIME - saves current time
-*                 E_REC_CMD_START - waits for command packet start
-*                 E_REC_CMD - saves command packet and runs command
-*                 E_REC_RESET - clears data saved from frame
+* Remarks       : Drains what the UART already holds in K_RX_CHUNK_SIZE reads and runs the FSM over each chunk.
+*                 Returns to loop() once the UART is empty, FSM state carries over to the next call so frames
+*                 may arrive split across calls. While idle, syncScan() skips the FSM to the next sync. Once
+*                 the length is accepted, frameFast() takes the rest of the frame if the UART already holds it.
+*                 Commands of the last verified ITF run once the UART is empty, so echoing them doesn't hold up
+*                 frames queued behind it. An ITF that verifies while another waits runs the waiting one first.
 **********************************************************************************************************************/
-void getData(void) {
-    // Reset frame values
-    reset();
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::getData(void) {
+    uint8_t chunk[K_RX_CHUNK_SIZE];
+    int available = port.available();
+
+    while (available > 0) {
+        // Read a chunk from UART
+        size_t chunk_len = available < K_RX_CHUNK_SIZE ? available : K_RX_CHUNK_SIZE;
+        chunk_len = port.readBytes(chunk, chunk_len);
+        if(chunk_len == 0) {
+            break;
+        }
+        available -= chunk_len;
+        rx_bytes += chunk_len;
+        if(capture_log != NULL) {
+            captureAppend(capture_log, CAPTURE_RX, capture_source, chunk, chunk_len);
+        }
+
+        for(size_t i = 0; i < chunk_len; i++) {
+#if INSTRUMENT_SYNC_SCAN
+            // Once the sync window is all chunk bytes, idle noise needs no FSM
+            if(state == E_REC_IDLE && i >= 3) {
+                i = syncScan(chunk, i, chunk_len);
+                if(i == chunk_len) {
+                    break;
+                }
+            }
+#endif
+            parseByte(chunk[i]);
+#if INSTRUMENT_FRAME_FAST
+            // Length just accepted
+            if(state == E_REC_TIME_START && g_read_count == K_INS_DATA_LEN_OFFSET) {
+                i += frameFast(&chunk[i + 1], chunk_len - i - 1, available);
+            }
+#endif
+        }
+    }
 
-    while (Serial2.available() > 0) {  
-        // Read a byte from UART
-        new_byte = Serial2.read();
+    // Reception caught up, the next ITF fills the other buffer while these run
+    if(rx_ready) {
+        processCommands();
+    }
+}
 
-        // Load most recent 4 bytes read
-        g_four_bytes = (g_four_bytes << 8) & 0xFFFFFF00;
-        g_four_bytes = g_four_bytes | new_byte;
+/**********************************************************************************************************************
+* Function      : size_t syncScan(const uint8_t* chunk, size_t start, size_t len)
+* Description   : Finds the next sync in an idle chunk and loads the FSM window as if every byte before it was parsed
+* Arguments     : const uint8_t* chunk, size_t start - next byte for the FSM, at least 3, size_t len
+* Returns       : size_t - index of the byte that completes the sync, len if there is none
+* Remarks       : Idle parseByte() only shifts the window, so skipping to the sync is bit-exact. Leads from start - 3
+*                 are checked so a sync already partly in the window is found, and every 0xFE is checked so
+*                 overlapping partial syncs resolve the same way. A sync cut by the end of the chunk is left to
+*                 the FSM, which the window carries into the next chunk.
+**********************************************************************************************************************/
+template <class CHECKSUM>
+size_t InstrumentDriver<CHECKSUM>::syncScan(const uint8_t *chunk, size_t start, size_t len) {
+    size_t found = len;
+    size_t lead = start - 3;
+    while(lead + 3 < len) {
+        const uint8_t *hit = (const uint8_t *)memchr(&chunk[lead], (SYNC >> 24) & 0xFF, len - 3 - lead);
+        if(hit == NULL) {
+            break;
+        }
+        lead = hit - chunk;
+        if(hit[1] == ((SYNC >> 16) & 0xFF) && hit[2] == ((SYNC >> 8) & 0xFF) && hit[3] == (SYNC & 0xFF)) {
+            found = lead + 3;
+            break;
+        }
+        lead++;
+    }
 
-        // Mask for recent 2 bytes read
+    // Window holds the 4 bytes before the one the FSM sees next
+    if(found > start) {
+        g_four_bytes = ((uint32_t)chunk[found - 4] << 24) | ((uint32_t)chunk[found - 3] << 16) |
+                       ((uint32_t)chunk[found - 2] << 8) | chunk[found - 1];
         g_two_bytes = g_four_bytes & 0xFFFF;
+        new_byte = chunk[found - 1];
+    }
+    return found;
+}
 
-        // If frame is being read, calculate crc
-        if(flag_sync_found == 1) {
-            // Count reads since synced
-            g_read_count++;
+/**********************************************************************************************************************
+* Function      : size_t frameFast(const uint8_t* tail, size_t tail_len, int& available)
+* Description   : Takes the rest of a frame whose length was just accepted, if it has all arrived, and checks it in
+*                 one pass instead of byte by byte
+* Arguments     : const uint8_t* tail, size_t tail_len - chunk bytes after the length,
+*                 int& available - bytes still in the UART from getData(), less any read here
+* Returns       : size_t - bytes of tail used, the rest of the frame is read from the UART
+* Remarks       : A frame frameLoad() doesn't accept is run through parseByte() from rx_frame, so alarms and
+*                 outputs are the FSM's whatever the frame holds. parseByte() writes rx_frame at or behind the byte
+*                 it is given, so it can run over the copy in place. A frame it verifies on the way swaps rx_frame,
+*                 the copy is still read from the buffer it was made in.
+**********************************************************************************************************************/
+template <class CHECKSUM>
+size_t InstrumentDriver<CHECKSUM>::frameFast(const uint8_t *tail, size_t tail_len, int &available) {
+    size_t need = g_data_len - K_INS_DATA_LEN_OFFSET;
+    if(tail_len + available < need) {
+        return 0;
+    }
 
-            // Add up crc of each byte in itf
-            crc_total = crc(crc_total, new_byte);
+    size_t from_chunk = tail_len < need ? tail_len : need;
+    memcpy(&rx_frame[K_INS_DATA_LEN_OFFSET], tail, from_chunk);
+    size_t got = from_chunk;
+    if(got < need) {
+        size_t read = port.readBytes(&rx_frame[K_INS_DATA_LEN_OFFSET + got], need - got);
+        available -= read;
+        rx_bytes += read;
+        if(capture_log != NULL) {
+            captureAppend(capture_log, CAPTURE_RX, capture_source, &rx_frame[K_INS_DATA_LEN_OFFSET + got], read);
+        }
+        got += read;
+    }
 
-            // Redundant overflow protection
-            if(g_read_count > K_MAX_PACKET_SIZE) {
-                // ITF bad length, send an alarm
-                flag_time_recieved = 0;
-                alarm(ITF_LENGTH);
-                // Force a reset
-                reset();
-            }
+    if(got == need && frameLoad()) {
+        frameEnd();
+        state = next_state;
+    }else {
+        const uint8_t *frame = rx_frame;
+        for(size_t k = K_INS_DATA_LEN_OFFSET; k < K_INS_DATA_LEN_OFFSET + got; k++) {
+            parseByte(frame[k]);
         }
+    }
+    return from_chunk;
+}
 
-        // Flag if end of frame has been read
-        if((g_read_count == g_data_len) && (g_read_count >= K_INS_DATA_LEN_OFFSET)) {
-            flag_end_reached = 1;
+/**********************************************************************************************************************
+* Function      : bool frameLoad()
+* Description   : Checks a whole frame in rx_frame has the layout the FSM accepts without an alarm, and if so leaves
+*                 the FSM as parseByte() would after its last byte
+* Arguments     : none
+* Returns       : bool - false leaves the FSM untouched, the frame needs parseByte()
+* Remarks       : Accepted: an optional time packet (0x1900, K_TIME_SIZE, bytes 19-46 reserved zero), then up to
+*                 K_MAX_CMDS back to back command packets (0x1B00, length in range), then the 2 byte checksum. The
+*                 checksum itself is left to frameEnd(). A command whose third trailer byte is zero loses an
+*                 argument to padding, as in E_REC_CMD.
+**********************************************************************************************************************/
+template <class CHECKSUM>
+bool InstrumentDriver<CHECKSUM>::frameLoad(void) {
+    const uint8_t *frame = rx_frame;
+    uint16_t len = g_data_len;
+    uint16_t pos = K_INS_HEADER_OFFSET - 2;
+    bool time = false;
+    uint16_t header = (frame[pos] << 8) | frame[pos + 1];
+
+    if(header == 0x1900) {
+        // A stale reserved byte error from a frame cut short would alarm here
+        if(flag_packet_error != 0 || len < K_INS_TIME_OFFSET + 30 + 2 ||
+           ((frame[K_INS_TIME_LENGTH_OFFSET - 2] << 8) | frame[K_INS_TIME_LENGTH_OFFSET - 1]) != K_TIME_SIZE) {
+            return false;
+        }
+        for(uint16_t k = K_INS_TIME_OFFSET + 1; k < K_INS_TIME_OFFSET + 29; k++) {
+            if(frame[k] != 0x00) {
+                return false;
+            }
         }
+        time = true;
+        pos = K_INS_TIME_OFFSET + 30;
+    }else if(header != 0x1B00) {
+        return false;
+    }
 
-        // Add a delay to allow for almost half fill of serial buff
-        if(Serial2.available() == 0 & flag_end_reached == 0){
-            delay(0.25);
+    // Commands fill the frame up to the checksum
+    uint8_t command_num = 0;
+    uint16_t cmd_length = g_cmd_length;
+    while(pos < len - 2) {
+        if(command_num == K_MAX_CMDS || len - 2 - pos < K_MIN_CMD_SIZE ||
+           ((frame[pos] << 8) | frame[pos + 1]) != 0x1B00) {
+            return false;
         }
+        uint16_t ccsds_len = (frame[pos + 6] << 8) | frame[pos + 7];
+        cmd_length = ccsds_len + K_INS_HEADER_OFFSET + 1;
+        if(cmd_length < K_MIN_CMD_SIZE || cmd_length > K_MAX_CMD_SIZE + 10 ||
+           pos + cmd_length + K_INS_HEADER_OFFSET - 1 > len - 2) {
+            return false;
+        }
+        CMD_DESC &desc = cmd_desc[command_num];
+        desc.offset = pos + K_INS_HEADER_OFFSET + 2;
+        desc.opcode = frame[pos + K_INS_HEADER_OFFSET + 2];
+        desc.macro = frame[pos + K_INS_HEADER_OFFSET + 3];
+        desc.length = ccsds_len - 3;
+        if(frame[pos + cmd_length + 2] == 0x00) {
+            desc.length--;
+        }
+        command_num++;
+        pos += cmd_length + K_INS_HEADER_OFFSET - 1;
+    }
 
-        switch (state) {
-        case E_REC_IDLE:
-            // Look for start of ITF
-            if (g_four_bytes == SYNC) {
-                // Trigger frame read
-                flag_sync_found = 1;
-                next_state = E_REC_LENGTH;
+    // The FSM looks for a command header over the checksum as well
+    if(pos != len - 2 || ((frame[len - 3] << 8) | frame[len - 2]) == 0x1B00 ||
+       ((frame[len - 2] << 8) | frame[len - 1]) == 0x1B00) {
+        return false;
+    }
 
-                // Set read count
-                g_read_count = 4;
+    g_command_num = command_num;
+    g_cmd_length = cmd_length;
+    flag_time_recieved = time ? 1 : 0;
+    if(time) {
+        g_time_rx = ((uint32_t)frame[K_INS_TIME_OFFSET - 4] << 24) | ((uint32_t)frame[K_INS_TIME_OFFSET - 3] << 16) |
+                    ((uint32_t)frame[K_INS_TIME_OFFSET - 2] << 8) | frame[K_INS_TIME_OFFSET - 1];
+    }
+    g_read_count = len;
+    g_four_bytes = ((uint32_t)frame[len - 4] << 24) | ((uint32_t)frame[len - 3] << 16) |
+                   ((uint32_t)frame[len - 2] << 8) | frame[len - 1];
+    g_two_bytes = g_four_bytes & 0xFFFF;
+    new_byte = frame[len - 1];
+    return true;
+}
 
-                // Update instrument MET (also will send status pack depending on interval)
-                instrumentUpdate(UPDATE_TIME);
-            }
-            break;
+/**********************************************************************************************************************
+* Function      : void parseByte(uint8_t rx_byte)
+* Description   : Runs one received byte through the frame FSM
+* Arguments     : uint8_t rx_byte
+* Returns       : none
+* Remarks       : State machine
+*                 E_REC_IDLE - wait for sync
+*                 E_REC_LENGTH - reads length of frame 
+*                 E_REC_TIME_START - waits for timestamp packet
+*                 E_REC_TIME - saves current time
+*                 E_REC_CMD_START - waits for command packet start
+*                 E_REC_CMD - saves command packet and runs command
+*                 E_REC_RESET - clears data saved from frame
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::parseByte(uint8_t rx_byte) {
+    new_byte = rx_byte;
 
-        case E_REC_LENGTH:
-            // Data length done reading in, saves and run checks then transition states
-            if (g_read_count == K_INS_DATA_LEN_OFFSET) {
-                // Save data length
-                g_data_len = g_two_bytes & ~0xE000; // Turn off first three bits so just length
-                g_data_len += K_INS_DATA_LEN_OFFSET; // Get total frame length
+    // Load most recent 4 bytes read
+    g_four_bytes = (g_four_bytes << 8) & 0xFFFFFF00;
+    g_four_bytes = g_four_bytes | new_byte;
 
-                // First three bits of g_data_len, should be 000 for commands
-                if(0 != (g_two_bytes & 0xE000)) {
-                    // CCSDS bad format, go to reset state
-                    alarm(CCSDS_FORMAT);
-                    reset();
-                }
+    // Mask for recent 2 bytes read
+    g_two_bytes = g_four_bytes & 0xFFFF;
 
-                // Check if packet is too big or too small
-                if (g_data_len < K_MAX_PACKET_SIZE && g_data_len > K_MIN_PACKET_SIZE) {
-                    // Good, go to next state
-                    next_state = E_REC_TIME_START;
-                } else {
-                    // ITF bad length, go to reset state
-                    flag_time_recieved = 0;
-                    alarm(ITF_LENGTH);
-                    reset();
-                }
-            }
-            break;
+    // If frame is being read, keep it for the checksum
+    if(flag_sync_found == 1) {
+        // Count reads since synced
+        g_read_count++;
 
-        case E_REC_TIME_START:
-            // Look for next timestamp packet header
-            if (g_read_count == K_INS_HEADER_OFFSET) {
-                // Timestamp header found
-                if(g_two_bytes == 0x1900) {
-                    next_state = E_REC_TIME;
-                }else {
-                    // No timestamp recieved
-                    flag_time_recieved = 0;
-                    // Check if command header
-                    if(g_two_bytes == 0x1B00) {
-                        next_state = E_REC_CMD;
-                        g_command_num ++;
-                        g_cmd_length = 0;
-                        g_cmd_read_count = 0;
-                        g_idle_count = 0;
-                    }else {
-                        // If correct APID in the header
-                        if((g_two_bytes & 0x7FF) == 0x100 || (g_two_bytes & 0x7FF) == 0x300) {
-                            // CCSDS bad format
-                            alarm(CCSDS_FORMAT);
-                        }else {
-                            // CCSDS bad APID
-                            alarm(CCSDS_APID);
-                        }
-                        // Trash packet and keep looking for commands
-                        next_state = E_REC_CMD_START;
-                   }
-                }
-            }
-            break;
-     
-        case E_REC_TIME:
+        // Keep the frame
+        if(g_read_count <= K_MAX_PACKET_SIZE) {
+            rx_frame[g_read_count - 1] = new_byte;
+        }
 
-            // Verify spacecraft time packet is correct size
-            if((g_read_count == K_INS_TIME_LENGTH_OFFSET) && (g_two_bytes != K_TIME_SIZE)) {
-                // CCSDS bad length, stop reading time packet
-                alarm(CCSDS_LENGTH);
-                next_state = E_REC_CMD_START;
-            }
+        // Redundant overflow protection
+        if(g_read_count > K_MAX_PACKET_SIZE) {
+            // ITF bad length, send an alarm
+            flag_time_recieved = 0;
+            alarm(ITF_LENGTH);
+            // Force a reset
+            reset();
+        }
+    }
 
-            // Save last four read bytes as the time
-            if(g_read_count == K_INS_TIME_OFFSET) {
-                flag_time_recieved = 1;
-                g_time_next = g_four_bytes;
-            }
+    // Flag if end of frame has been read
+    if((g_read_count == g_data_len) && (g_read_count >= K_INS_DATA_LEN_OFFSET)) {
+        flag_end_reached = 1;
+    }
 
-            // Verify bytes are reserved
-            if((g_read_count < K_INS_TIME_OFFSET + 30) && (g_read_count > K_INS_TIME_OFFSET + 2) && (g_two_bytes != 0x00)) {
-                // CCSDS bad format flag
-                flag_packet_error = 1;
-            }
+    switch (state) {
+    case E_REC_IDLE:
+        // Look for start of ITF
+        if (g_four_bytes == SYNC) {
+            // Trigger frame read
+            flag_sync_found = 1;
+            next_state = E_REC_LENGTH;
+
+            // Set read count
+            g_read_count = 4;
+            rx_frame[0] = (SYNC >> 24) & 0xFF;
+            rx_frame[1] = (SYNC >> 16) & 0xFF;
+            rx_frame[2] = (SYNC >> 8) & 0xFF;
+            rx_frame[3] = SYNC & 0xFF;
+
+            lat_sync_us = micros();
+        }
+        break;
 
-            // Done processing spacecraft time packet
-            if(g_read_count == K_INS_TIME_OFFSET + 30) {
-                if(flag_packet_error == 1) {
-                    // CCSDS bad format, send alarm trash time packet
-                    alarm(CCSDS_FORMAT);
-                    flag_time_recieved = 0;
-                    flag_packet_error = 0;
-                }
-                next_state = E_REC_CMD_START;
+    case E_REC_LENGTH:
+        // Data length done reading in, saves and run checks then transition states
+        if (g_read_count == K_INS_DATA_LEN_OFFSET) {
+            // Save data length
+            g_data_len = g_two_bytes & ~0xE000; // Turn off first three bits so just length
+            g_data_len += K_INS_DATA_LEN_OFFSET; // Get total frame length
+
+            // First three bits of g_data_len, should be 000 for commands
+            if(0 != (g_two_bytes & 0xE000)) {
+                // CCSDS bad format, go to reset state
+                alarm(CCSDS_FORMAT);
+                reset();
             }
-            break;
-           
-        case E_REC_CMD_START:
-
-            g_idle_count ++;
-            // Look for command packet header
-            if(g_two_bytes == 0x1B00) {
-                // Start a new command read
-                next_state = E_REC_CMD;
-                // Save the index where the command starts
-                cmd_location_info[g_command_num] = g_cmd_read_total;
-                g_command_num ++;
-                g_cmd_length = 0;
-                g_cmd_read_count = 0;
-                g_idle_count = 0;
+
+            // Check if packet is too big or too small
+            if (g_data_len < K_MAX_PACKET_SIZE && g_data_len > K_MIN_PACKET_SIZE) {
+                // Good, go to next state
+                next_state = E_REC_TIME_START;
+            } else {
+                // ITF bad length, go to reset state
+                flag_time_recieved = 0;
+                alarm(ITF_LENGTH);
+                reset();
             }
-            
-            // Idling in CMD_START for too long looking for header
-            if(g_idle_count > 2) {
-                // Exclude CRC
-                if(g_read_count <= g_data_len-2){
-                    // Bad packet
-                    if((g_two_bytes & 0x7FF) == 0x300) {
+        }
+        break;
+
+    case E_REC_TIME_START:
+        // Look for next timestamp packet header
+        if (g_read_count == K_INS_HEADER_OFFSET) {
+            // Timestamp header found
+            if(g_two_bytes == 0x1900) {
+                next_state = E_REC_TIME;
+            }else {
+                // No timestamp recieved
+                flag_time_recieved = 0;
+                // Check if command header
+                if(g_two_bytes == 0x1B00) {
+                    next_state = E_REC_CMD;
+                    g_cmd_length = 0;
+                    g_cmd_read_count = 0;
+                    g_idle_count = 0;
+                }else {
+                    // If correct APID in the header
+                    if((g_two_bytes & 0x7FF) == 0x100 || (g_two_bytes & 0x7FF) == 0x300) {
                         // CCSDS bad format
                         alarm(CCSDS_FORMAT);
                     }else {
                         // CCSDS bad APID
                         alarm(CCSDS_APID);
                     }
-                }
-
-                // Restart idling to look for new packet
-                g_idle_count = 0;
+                    // Trash packet and keep looking for commands
+                    next_state = E_REC_CMD_START;
+               }
             }
-            break;
+        }
+        break;
+ 
+    case E_REC_TIME:
 
-        case E_REC_CMD:
-            // Every byte since command packet header found
-            g_cmd_read_total ++;
-            g_cmd_read_count ++; // Doesn't roll over
-
-            // Save command packet length
-            if(g_cmd_read_count == K_INS_DATA_LEN_OFFSET) {
-                // Save command Length
-                g_cmd_length = g_two_bytes + K_INS_HEADER_OFFSET + 1;
-                //Save number of arguments 
-                cmd_location_info[g_command_num] = g_two_bytes - 3;
-                // Verify command packet length
-                if(g_cmd_length < K_MIN_CMD_SIZE || g_cmd_length > (K_MAX_CMD_SIZE + 10)) {
-                    // CCSDS bad length, look for new command (or frame end will be hit)
-                    alarm(CCSDS_LENGTH);
-                    next_state = E_REC_CMD_START;
-                    // Remove current save info for command
-                    cmd_location_info[g_command_num] = 0x00;
-                    cmd_location_info[g_command_num-1] = 0x00;
-                    g_cmd_read_total -= K_INS_DATA_LEN_OFFSET;
-                    g_cmd_read_count -= K_INS_DATA_LEN_OFFSET;
-                    g_command_num --;
-                }
+        // Verify spacecraft time packet is correct size
+        if((g_read_count == K_INS_TIME_LENGTH_OFFSET) && (g_two_bytes != K_TIME_SIZE)) {
+            // CCSDS bad length, stop reading time packet
+            alarm(CCSDS_LENGTH);
+            next_state = E_REC_CMD_START;
+        }
+
+        // Save last four read bytes as the time
+        if(g_read_count == K_INS_TIME_OFFSET) {
+            flag_time_recieved = 1;
+            g_time_rx = g_four_bytes;
+        }
+
+        // Verify bytes are reserved
+        if((g_read_count < K_INS_TIME_OFFSET + 30) && (g_read_count > K_INS_TIME_OFFSET + 2) && (g_two_bytes != 0x00)) {
+            // CCSDS bad format flag
+            flag_packet_error = 1;
+        }
+
+        // Done processing spacecraft time packet
+        if(g_read_count == K_INS_TIME_OFFSET + 30) {
+            if(flag_packet_error == 1) {
+                // CCSDS bad format, send alarm trash time packet
+                alarm(CCSDS_FORMAT);
+                flag_time_recieved = 0;
+                flag_packet_error = 0;
+            }
+            next_state = E_REC_CMD_START;
+        }
+        break;
+       
+    case E_REC_CMD_START:
+
+        g_idle_count ++;
+        // Look for command packet header
+        if(g_two_bytes == 0x1B00) {
+            // No descriptor left for another command
+            if(g_command_num == K_MAX_CMDS) {
+                // ITF bad length, send an alarm
+                flag_time_recieved = 0;
+                alarm(ITF_LENGTH);
+                // Force a reset
+                reset();
+                break;
             }
-            // Save command
-            if(g_cmd_read_count > K_INS_HEADER_OFFSET){
-                // Redundant overflow protection
-                if(g_cmd_read_total > (K_MAX_CMD_SIZE * K_MAX_CMDS)) {
-                    // ITF bad length, send an alarm
-                    flag_time_recieved = 0;
-                    alarm(ITF_LENGTH);
-                    // Force a reset
-                    reset();
+            // Start a new command read
+            next_state = E_REC_CMD;
+            g_cmd_length = 0;
+            g_cmd_read_count = 0;
+            g_idle_count = 0;
+        }
+        
+        // Idling in CMD_START for too long looking for header
+        if(g_idle_count > 2) {
+            // Exclude CRC
+            if(g_read_count <= g_data_len-2){
+                // Bad packet
+                if((g_two_bytes & 0x7FF) == 0x300) {
+                    // CCSDS bad format
+                    alarm(CCSDS_FORMAT);
                 }else {
-                    // Remove padding if present
-                    if((new_byte == 0x00) && (g_cmd_read_count == g_cmd_length+1)) {
-                        cmd_location_info[g_command_num]--;
-                        g_cmd_read_total--;
-                    }else {
-                        cmd_packets[g_cmd_read_total - K_INS_HEADER_OFFSET - 1] = new_byte;
-                    }
+                    // CCSDS bad APID
+                    alarm(CCSDS_APID);
                 }
             }
-            // Command read success
-            if(g_cmd_read_count == (g_cmd_length + K_INS_DATA_LEN_OFFSET + 1)) {
-                // Find new command (or frame end will be hit)
-                next_state = E_REC_CMD_START;
-                g_command_num ++;
-            }
-            break;
-        }
 
-        if(flag_end_reached == 1) {
-            flag_end_reached = 0;
+            // Restart idling to look for new packet
+            g_idle_count = 0;
+        }
+        break;
 
-            // Conduct CRC
-            if(crc_total == 0x0000) {
-                // All commands have been loaded and verified, execute them
-                processCommands();
-            }else {
-                // ITF bad checksum, send an alarm
-                flag_time_recieved = 0;
-                alarm(ITF_CHECKSUM);
+    case E_REC_CMD:
+        // Every byte since command packet header found
+        g_cmd_read_count ++; // Doesn't roll over
+
+        // Save command packet length
+        if(g_cmd_read_count == K_INS_DATA_LEN_OFFSET) {
+            // Save command Length
+            g_cmd_length = g_two_bytes + K_INS_HEADER_OFFSET + 1;
+            //Save number of arguments 
+            cmd_desc[g_command_num].length = g_two_bytes - 3;
+            // Verify command packet length
+            if(g_cmd_length < K_MIN_CMD_SIZE || g_cmd_length > (K_MAX_CMD_SIZE + 10)) {
+                // CCSDS bad length, look for new command (or frame end will be hit)
+                alarm(CCSDS_LENGTH);
+                next_state = E_REC_CMD_START;
+                g_cmd_read_count = 0;
             }
-
-            // Reset all values changed from reading frame
-            reset();
         }
+        // Opcode and macro, arguments follow them in rx_frame
+        if(g_cmd_read_count == K_INS_HEADER_OFFSET + 1) {
+            cmd_desc[g_command_num].offset = g_read_count - 1;
+            cmd_desc[g_command_num].opcode = new_byte;
+        }
+        if(g_cmd_read_count == K_INS_HEADER_OFFSET + 2) {
+            cmd_desc[g_command_num].macro = new_byte;
+        }
+        // Remove padding if present
+        if((g_cmd_read_count > K_INS_HEADER_OFFSET) && (new_byte == 0x00) && (g_cmd_read_count == g_cmd_length+1)) {
+            cmd_desc[g_command_num].length--;
+        }
+        // Command read success
+        if(g_cmd_read_count == (g_cmd_length + K_INS_DATA_LEN_OFFSET + 1)) {
+            // Find new command (or frame end will be hit)
+            next_state = E_REC_CMD_START;
+            g_command_num ++;
+        }
+        break;
+    }
 
-        state = next_state;
+    if(flag_end_reached == 1) {
+        flag_end_reached = 0;
+        frameEnd();
     }
+
+    state = next_state;
 }
 
 /**********************************************************************************************************************
-* Function      : void buildCRC(uint_16_t)
-* Description   : Calculates the crc for a given byte for lookup table
+* Function      : void frameEnd()
+* Description   : Checks the frame's checksum, then queues its commands or raises the alarm, and resets the FSM
 * Arguments     : none
 * Returns       : none
+* Remarks       : A verified frame's buffer is handed to processCommands() and the FSM moves to the other one. If
+*                 the other still holds a frame waiting to run, it runs now so commands keep their order.
 **********************************************************************************************************************/
-void buildCRC() {
-    for(int i = 0; i<256; i++){
-        // Initialize lookup table seed
-        CRC_LOOKUP[i] = CRC_SEED_TABLE;
-
-        // Append data into the top part of the checksum so it is the most significant
-        CRC_LOOKUP[i] ^= ((i << 8) & 0xFFFF);
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::frameEnd(void) {
+    // Checksum the whole frame in one pass, trailer excluded
+    uint16_t check = CHECKSUM::update(CHECKSUM::seed, &rx_frame[K_TLM_CRC_OFFSET], g_data_len - K_TLM_CRC_OFFSET - 2);
+    if(!CHECKSUM::verified || check == ((rx_frame[g_data_len - 2] << 8) | rx_frame[g_data_len - 1])) {
+        RX_BUFFER &filled = rx_buffs[rx_fill];
+        filled.command_num = g_command_num;
+        filled.sync_us = lat_sync_us;
+        filled.crc_us = micros();
+        latencyAdd(LAT_RX, filled.crc_us - lat_sync_us);
+
+        // Time is only trusted once the frame checks out
+        if(flag_time_recieved == 1) {
+            g_time_next = g_time_rx;
+            flag_time_pending = 1;
+        }
 
-        // Go through all of the new 8 bits and divide the polynomial
-        for (uint8_t j = 0; j < 8; j++) {
-            // If uppermost bit on
-            if (CRC_LOOKUP[i] & 0x8000) {
-                // Shift 1 out, subtract polynomial from checksum
-                CRC_LOOKUP[i] = (CRC_LOOKUP[i] << 1) ^ CRC_POLY;
-            }else {
-                // Shift 0 out, polynomial doesn't fit
-                CRC_LOOKUP[i] = (CRC_LOOKUP[i] << 1);
-            }
+        // All commands have been loaded and verified, queue them and read the next ITF into the other buffer
+        rx_frames++;
+        if(rx_ready) {
+            processCommands();
         }
+        rx_ready = 1;
+        rx_fill ^= 1;
+        rx_frame = rx_buffs[rx_fill].frame;
+        cmd_desc = rx_buffs[rx_fill].cmd_desc;
+    }else {
+        // ITF bad checksum, send an alarm
+        flag_time_recieved = 0;
+        rx_crc_failures++;
+        alarm(ITF_CHECKSUM);
     }
-}
-
-/**********************************************************************************************************************
-* Function      : uint16_t crc(uint_16_t)
-* Description   : Calculates the checksum for a given byte
-* Arguments     : uint816_t checksum, uint8_t data
-* Returns       : uint16_t
-* Remarks       : none
-**********************************************************************************************************************/
-uint16_t crc(uint16_t checksum, uint8_t data) {
-    // Shift new data into current checksum
-    uint8_t lookup = ((checksum >> 8) ^ data) & 0xFF;
-
-    // XOR the crc value with the shifted checksum
-    checksum = (checksum << 8) ^ CRC_LOOKUP[lookup];
 
-   // Return the remainder of dividing data with polynomial
-   return checksum;
+    // Reset all values changed from reading frame
+    reset();
 }
 
 /**********************************************************************************************************************
@@ -378,20 +684,26 @@ uint16_t crc(uint16_t checksum, uint8_t data) {
 * Description   : Sets all saved values in the frame to zero
 * Arguments     : none
 * Returns       : none
+* Remarks       : rx_frame and cmd_desc are not cleared, g_command_num is the count of valid descriptors and every
+*                 byte they point at is written by the FSM before it is read. A frame waiting to run is kept.
+*                 Alarms coalesced without a window are sent here, once per ITF.
 **********************************************************************************************************************/
-void reset(void){
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::reset(void){
     state = E_REC_IDLE;     
     next_state = E_REC_IDLE;
     flag_sync_found = 0;
+    flag_time_recieved = 0;
     g_read_count = 0;
     g_command_num = 0;
     g_cmd_read_count = 0;
-    g_cmd_read_total = 0;
+    g_idle_count = 0;
     g_data_len = 0;
     flag_end_reached = 0;
-    crc_total = CRC_SEED;
-    memset(cmd_packets, 0x00, K_MAX_CMD_SIZE * 10);
-    memset(cmd_location_info, 0x0000, 20);
+
+    if(alarm_mode == ALARM_COALESCE && alarm_schedule.period_us == 0) {
+        alarmFlush();
+    }
 }
 
 /**********************************************************************************************************************
@@ -401,24 +713,18 @@ void reset(void){
 * Returns       : none
 * Remarks       : none
 **********************************************************************************************************************/
-void instrumentUpdate(UPDATE_STATE update_arg) {
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::instrumentUpdate(UPDATE_STATE update_arg) {
    switch(update_arg){
        // Update if time was recieved, otherwise increment by 1
        case UPDATE_TIME:
-           if(flag_time_recieved == 1) {
+           if(flag_time_pending == 1) {
                i_time = g_time_next;
-               flag_time_recieved = 0;
+               flag_time_pending = 0;
            }else {
                i_time ++;
            }
-
-           // At every time interval update, a status packet may be sent 
-            status_send_counter ++;
-            if(status_send_counter == i_status_send && i_status_send != 0){
-                status();
-                status_send_counter = 0;
-            }
-            break;
+           break;
 
        // Increment sequence count
        case UPDATE_SEQUENCE:
@@ -445,283 +751,1222 @@ void instrumentUpdate(UPDATE_STATE update_arg) {
 }
 
 /**********************************************************************************************************************
-* Function      : void executeCommand()
-* Description   : Pretends to execute commands then echo back a sucessful execution
+* Function      : void processCommands()
+* Description   : Executes each command of the waiting ITF through CMD_TABLE and echoes back the result
 * Arguments     : none
 * Returns       : none
+* Remarks       : In batch mode the echoes are packed into one TLM frame as they are made. The mode is taken once
+*                 per ITF, a K_INS_CMD_ECHO_MODE takes effect from the next one. The buffer is free again once
+*                 this returns.
 **********************************************************************************************************************/
-void processCommands(void) {
-    for(int i=0; i < g_command_num-1; i+=2) {
-        // Pretend command executed successfully
-        // Execute command, OPCODE: cmd_packets[cmd_location_info[i]] MACRO: cmd_packets[cmd_location_info[i +1]], ARGS after
-        uint8_t command_result = 0x00;
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::processCommands(void) {
+    const RX_BUFFER &ready = rx_buffs[rx_fill ^ 1];
+    cmd_frame = ready.frame;
+    lat_cmd_sync_us = ready.sync_us;
+    lat_proc_us = micros();
+    latencyAdd(LAT_DISPATCH, lat_proc_us - ready.crc_us);
+
+    uint8_t batch = g_echo_batch;
+    uint8_t *tlm_packet = NULL;
+    int pack_size = K_INS_DATA_LEN_OFFSET;
+    if(batch && ready.command_num > 0) {
+        // NULL on a full queue, the commands still run but the batch is dropped
+        tlm_packet = txAcquire();
+    }
+
+    for(uint8_t i = 0; i < ready.command_num; i++) {
+        const CMD_DESC &cmd = ready.cmd_desc[i];
+        uint8_t command_result = (this->*CMD_TABLE.handler[cmd.opcode])(cmd);
+        cmd_executed++;
 
-        // Echo command if one was saved
-        echo(cmd_location_info[i+1], cmd_location_info[i], command_result);
+        // Echo command, read in place from cmd_frame
+        if(!batch) {
+            echo(cmd, command_result);
+        }else if(tlm_packet != NULL) {
+            pack_size += echoPacket(&tlm_packet[pack_size], cmd, command_result);
+        }
+    }
+
+    if(tlm_packet != NULL) {
+        echoBatchSend(tlm_packet, pack_size);
     }
+    rx_ready = 0;
 }
 
 /**********************************************************************************************************************
-* Function      : void sendData(unint8_t* tlm_packet, int pack_size)
-* Description   : Sends the TLM packet out via the Teensy's Serial 2 port
-* Arguments     : int pack_size - size of the packet to be sent
-* Returns      : none
+* Function      : uint8_t cmdEcho(const CMD_DESC &cmd)
+* Description   : Default handler, the command is only echoed back
+* Arguments     : const CMD_DESC &cmd
+* Returns       : uint8_t - K_CMD_SUCCESS
 **********************************************************************************************************************/
-void sendData(int pack_size) {
-    Serial2.write(tlm_packet, pack_size);
-    // Tiktok after every frame
-    instrumentUpdate(TOGGLE_HEART);
+template <class CHECKSUM>
+uint8_t InstrumentDriver<CHECKSUM>::cmdEcho(const CMD_DESC &cmd) {
+    (void)cmd;
+    return K_CMD_SUCCESS;
 }
 
 /**********************************************************************************************************************
-* Function      : void status()
-* Description   : Builds a status packet on TLM frame after designated interval (i_status_send)
-* Arguments     : none
-* Returns      : none
+* Function      : uint8_t cmdSurvey(const CMD_DESC &cmd)
+* Description   : Turns survey mode on or off and sets the survey packet length
+* Arguments     : const CMD_DESC &cmd - enable, length high, length low
+* Returns       : uint8_t - K_CMD_SUCCESS, K_CMD_BAD_ARGS if the arguments are malformed (mode unchanged)
+* Remarks       : The length is the whole science frame in bytes, K_SCIENCE_MIN_SIZE to K_MAX_TLM_SIZE
 **********************************************************************************************************************/
-void status() {
-    // Verifies old tlm has sent before replacing tlm packet
-    Serial2.flush();
-    
-    // Increase sequence count
-    instrumentUpdate(UPDATE_SEQUENCE);
-
-    // Set pack_size (args 124 + header of 16)
-    int pack_size = 140;
-
-    // Initialize packet
-    memset(tlm_packet, 0x00, K_MAX_TLM_SIZE);
-
-    // Telemetry ITF Header
-    // Sync
-    tlm_packet[0] = 0xFE;
-    tlm_packet[1] = 0xFA;
-    tlm_packet[2] = 0x30;
-    tlm_packet[3] = 0xC8;
-    // Alive, Power Down, Spare, Length (Aliveness toggled in sim)
-    int e_data_len = pack_size - K_INS_DATA_LEN_OFFSET;
-    tlm_packet[4] = i_heartbeat | i_power | ((e_data_len  >> 8) & 0xFF);
-    // Length
-    tlm_packet[5] = e_data_len  & 0xFF;
-    // Status Header
-    // Version, Type, Secondary, APID
-    int s_apid = 0x305;
-    tlm_packet[6] = 0x08 | ((s_apid >> 8) & 0x07);
-    // APID
-    tlm_packet[7] = (s_apid & 0xFF);
-    // Grouping, Sequence Count: 11XXXXXX
-    tlm_packet[8] = 0xC0 | ((i_sequence_count >> 8) & 0xFF);
-    // Sequence Count: XXXXXXXX
-    tlm_packet[9] = (i_sequence_count) & 0xFF;
-    // Length of packet after this byte:
-    e_data_len = 123;
-    tlm_packet[10] = (e_data_len >> 8) & 0xFF;
-    tlm_packet[11] = e_data_len & 0xFF;
- 
-    // Time tag (4 bytes) when command was executed
-    tlm_packet[12] = (i_time >> 24) & 0xFF;
-    tlm_packet[13] = (i_time >> 16) & 0xFF;
-    tlm_packet[14] = (i_time >> 8) & 0xFF;
-    tlm_packet[15] = i_time & 0xFF;
-
-    // FIXME: Arguments filled with dummy values
-    // ANALOG: 16-47
-    // DIGITAL: 48-102
-    // SOFTWARE: 102-137
-
-    // Checksum at end
-    int temp_check = CRC_SEED;
-    for (size_t i = 4; i < pack_size-2; i++) {
-        temp_check = crc(temp_check, tlm_packet[i]);
+template <class CHECKSUM>
+uint8_t InstrumentDriver<CHECKSUM>::cmdSurvey(const CMD_DESC &cmd) {
+    const uint8_t *args = &cmd_frame[cmd.offset + 2];
+    uint16_t surv_len = (args[1] << 8) | args[2];
+    if(cmd.length != K_CMD_MODE_ARGS || args[0] > 1 || surv_len > K_MAX_TLM_SIZE ||
+       (args[0] == 1 && surv_len < K_SCIENCE_MIN_SIZE)) {
+        return K_CMD_BAD_ARGS;
     }
-  
-    tlm_packet[138] = (temp_check >> 8) & 0xFF;
-    tlm_packet[139] = temp_check;
+    g_surv_enabled = args[0];
+    g_surv_len = surv_len;
+    return K_CMD_SUCCESS;
+}
 
-    // Send status packet
-    sendData(pack_size);
+/**********************************************************************************************************************
+* Function      : uint8_t cmdBurst(const CMD_DESC &cmd)
+* Description   : Turns burst mode on or off and sets the burst packet length
+* Arguments     : const CMD_DESC &cmd - enable, length high, length low
+* Returns       : uint8_t - K_CMD_SUCCESS, K_CMD_BAD_ARGS if the arguments are malformed (mode unchanged)
+* Remarks       : Burst takes over from survey while enabled
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint8_t InstrumentDriver<CHECKSUM>::cmdBurst(const CMD_DESC &cmd) {
+    const uint8_t *args = &cmd_frame[cmd.offset + 2];
+    uint16_t burst_len = (args[1] << 8) | args[2];
+    if(cmd.length != K_CMD_MODE_ARGS || args[0] > 1 || burst_len > K_MAX_TLM_SIZE ||
+       (args[0] == 1 && burst_len < K_SCIENCE_MIN_SIZE)) {
+        return K_CMD_BAD_ARGS;
+    }
+    g_burst_enabled = args[0];
+    g_burst_len = burst_len;
+    return K_CMD_SUCCESS;
 }
 
 /**********************************************************************************************************************
-* Function     : uint16_t* buildEcho(int pack_size)
-* Description  : Builds the simulated echo packet into TLM frame
-* Arguments    : uint16_t arg_count, int cmd_location_head, uint8_t command_result
-* Returns      : none
+* Function      : uint8_t cmdLink(const CMD_DESC &cmd)
+* Description   : Changes the UART baud rate and framing
+* Arguments     : const CMD_DESC &cmd - baud (4 bytes), LINK_FORMAT
+* Returns       : uint8_t - K_CMD_SUCCESS, K_CMD_BAD_ARGS if the arguments are malformed (link unchanged)
+* Remarks       : The change waits in linkService() until this echo and everything queued before it has gone out
+*                 at the old rate
 **********************************************************************************************************************/
-void echo(uint16_t arg_count, uint16_t cmd_location_head, uint8_t command_result) {
-    // Verifies old tlm has sent before replacing tlm packet
-    Serial2.flush();
-    
-    // Increase sequence count
-    instrumentUpdate(UPDATE_SEQUENCE);
+template <class CHECKSUM>
+uint8_t InstrumentDriver<CHECKSUM>::cmdLink(const CMD_DESC &cmd) {
+    const uint8_t *args = &cmd_frame[cmd.offset + 2];
+    uint32_t baud = ((uint32_t)args[0] << 24) | ((uint32_t)args[1] << 16) | (args[2] << 8) | args[3];
+    if(cmd.length != K_CMD_LINK_ARGS || baud < K_LINK_MIN_BAUD || baud > K_LINK_MAX_BAUD ||
+       args[4] >= LINK_FORMATS) {
+        return K_CMD_BAD_ARGS;
+    }
+    link_pending_baud = baud;
+    link_pending_format = (LINK_FORMAT)args[4];
+    link_pending = 1;
+    return K_CMD_SUCCESS;
+}
 
-    // Maxmimum aruments that can be sent
-    if(arg_count>10){
-        arg_count = 10;
+/**********************************************************************************************************************
+* Function      : uint8_t cmdLinkTest(const CMD_DESC &cmd)
+* Description   : Starts a link self-test, linkTestReport() is sent when it ends
+* Arguments     : const CMD_DESC &cmd - test length in ms (2 bytes)
+* Returns       : uint8_t - K_CMD_SUCCESS, K_CMD_BAD_ARGS if the arguments are malformed
+* Remarks       : Restarts a test already running
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint8_t InstrumentDriver<CHECKSUM>::cmdLinkTest(const CMD_DESC &cmd) {
+    const uint8_t *args = &cmd_frame[cmd.offset + 2];
+    uint16_t test_ms = (args[0] << 8) | args[1];
+    if(cmd.length != K_CMD_LINK_TEST_ARGS || test_ms == 0) {
+        return K_CMD_BAD_ARGS;
     }
+    link_test_running = 1;
+    link_test_start_us = micros();
+    link_test_us = test_ms * 1000UL;
+    link_test_rx_bytes = rx_bytes;
+    link_test_rx_frames = rx_frames;
+    link_test_crc_failures = rx_crc_failures;
+    link_test_overruns = port.rxOverruns();
+    link_test_tx_bytes = tx_bytes;
+    link_test_tx_dropped = tx_dropped;
+    return K_CMD_SUCCESS;
+}
 
-    // Set pack_size
-    int pack_size = arg_count + 20;
+/**********************************************************************************************************************
+* Function      : uint8_t cmdEchoMode(const CMD_DESC &cmd)
+* Description   : Picks one TLM frame per echo or one for all echoes of an ITF
+* Arguments     : const CMD_DESC &cmd - 0 one frame per echo, 1 batched
+* Returns       : uint8_t - K_CMD_SUCCESS, K_CMD_BAD_ARGS if the arguments are malformed (mode unchanged)
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint8_t InstrumentDriver<CHECKSUM>::cmdEchoMode(const CMD_DESC &cmd) {
+    const uint8_t *args = &cmd_frame[cmd.offset + 2];
+    if(cmd.length != K_CMD_ECHO_MODE_ARGS || args[0] > 1) {
+        return K_CMD_BAD_ARGS;
+    }
+    g_echo_batch = args[0];
+    return K_CMD_SUCCESS;
+}
 
-    // Check if padding is needed
-    if(pack_size % 2 == 1) {
-        // Make the size even
-        pack_size ++;
+/**********************************************************************************************************************
+* Function      : uint8_t cmdStatusRate(const CMD_DESC &cmd)
+* Description   : Sets the status period, faster than 1 pps for stress tests
+* Arguments     : const CMD_DESC &cmd - period in ms (2 bytes), 0 stops status
+* Returns       : uint8_t - K_CMD_SUCCESS, K_CMD_BAD_ARGS if the arguments are malformed (period unchanged)
+* Remarks       : The next status is one new period from now and the jitter figures start over
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint8_t InstrumentDriver<CHECKSUM>::cmdStatusRate(const CMD_DESC &cmd) {
+    const uint8_t *args = &cmd_frame[cmd.offset + 2];
+    if(cmd.length != K_CMD_STATUS_RATE_ARGS) {
+        return K_CMD_BAD_ARGS;
     }
-    // Initialize packet
-    memset(tlm_packet, 0x00, K_MAX_TLM_SIZE);
+    uint16_t period_ms = (args[0] << 8) | args[1];
+    scheduleStart(status_schedule, period_ms * 1000UL, micros());
+    return K_CMD_SUCCESS;
+}
 
-    // Telemetry ITF Header
-    // Sync
-    tlm_packet[0] = 0xFE;
-    tlm_packet[1] = 0xFA;
-    tlm_packet[2] = 0x30;
-    tlm_packet[3] = 0xC8;
+/**********************************************************************************************************************
+* Function      : uint8_t cmdAlarmMode(const CMD_DESC &cmd)
+* Description   : Picks coalesced or immediate alarms
+* Arguments     : const CMD_DESC &cmd - ALARM_MODE, then a period in ms (2 bytes). Coalesced, the window counts are
+*                 held for, 0 for one packet per type per ITF. Immediate, the token period, 0 uncapped.
+* Returns       : uint8_t - K_CMD_SUCCESS, K_CMD_BAD_ARGS if the arguments are malformed (mode unchanged)
+* Remarks       : Taken up by alarmService(), handlers must not queue telemetry while a batch echo slot is open
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint8_t InstrumentDriver<CHECKSUM>::cmdAlarmMode(const CMD_DESC &cmd) {
+    const uint8_t *args = &cmd_frame[cmd.offset + 2];
+    if(cmd.length != K_CMD_ALARM_MODE_ARGS || args[0] > ALARM_COALESCE) {
+        return K_CMD_BAD_ARGS;
+    }
+    alarm_pending_mode = (ALARM_MODE)args[0];
+    alarm_pending_period_us = ((args[1] << 8) | args[2]) * 1000UL;
+    alarm_mode_pending = 1;
+    return K_CMD_SUCCESS;
+}
+
+/**********************************************************************************************************************
+* Function      : void scheduleStart(SCHEDULE &sched, uint32_t period_us, uint32_t now_us)
+* Description   : Sets the period, first tick one period from now_us, and clears the jitter figures
+* Arguments     : SCHEDULE &sched, uint32_t period_us - 0 stops it, uint32_t now_us
+* Returns       : none
+**********************************************************************************************************************/
+void scheduleStart(SCHEDULE &sched, uint32_t period_us, uint32_t now_us) {
+    sched.period_us = period_us;
+    sched.next_us = now_us + period_us;
+    sched.late_us = 0;
+    sched.late_max_us = 0;
+    sched.late_sum_us = 0;
+    sched.ticks = 0;
+    sched.missed = 0;
+}
+
+/**********************************************************************************************************************
+* Function      : uint32_t scheduleDue(SCHEDULE &sched, uint32_t now_us)
+* Description   : Checks for a tick and records how late it is
+* Arguments     : SCHEDULE &sched, uint32_t now_us
+* Returns       : uint32_t - periods that have passed since the last tick, 0 if not due yet
+* Remarks       : Lateness is measured against the latest deadline passed, earlier ones count as missed. Wraps
+*                 with micros() every 71 minutes.
+**********************************************************************************************************************/
+uint32_t scheduleDue(SCHEDULE &sched, uint32_t now_us) {
+    if(sched.period_us == 0 || (int32_t)(now_us - sched.next_us) < 0) {
+        return 0;
+    }
+
+    uint32_t late_us = now_us - sched.next_us;
+    uint32_t periods = late_us / sched.period_us + 1;
+    late_us -= (periods - 1) * sched.period_us;
+    sched.next_us += periods * sched.period_us;
+
+    sched.late_us = late_us;
+    if(late_us > sched.late_max_us) {
+        sched.late_max_us = late_us;
+    }
+    sched.late_sum_us += late_us;
+    sched.ticks++;
+    sched.missed += periods - 1;
+    return periods;
+}
+
+/**********************************************************************************************************************
+* Function      : void statusBegin()
+* Description   : Lines the MET and status schedules up with the clock, call once from setup()
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::statusBegin(void) {
+    uint32_t now_us = micros();
+    scheduleStart(met_schedule, K_MET_PERIOD_US, now_us);
+    scheduleStart(status_schedule, status_schedule.period_us, now_us);
+    scheduleStart(diag_schedule, K_DIAG_PERIOD_US, now_us);
+}
+
+/**********************************************************************************************************************
+* Function      : void statusService()
+* Description   : Ticks MET and sends status and latency diagnostics on their schedules
+* Arguments     : none
+* Returns       : none
+* Remarks       : Call from loop(). Runs off micros() whether or not the OBC is talking. MET catches up a tick for
+*                 every second missed, status only sends the latest.
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::statusService(void) {
+    uint32_t now_us = micros();
+    for(uint32_t ticks = scheduleDue(met_schedule, now_us); ticks > 0; ticks--) {
+        instrumentUpdate(UPDATE_TIME);
+    }
+    if(scheduleDue(status_schedule, now_us) > 0) {
+        status();
+    }
+    if(scheduleDue(diag_schedule, now_us) > 0) {
+        latencyReport();
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : const SCHEDULE& statusSchedule()
+* Description   : Status cadence and jitter
+* Arguments     : none
+* Returns       : const SCHEDULE&
+**********************************************************************************************************************/
+template <class CHECKSUM>
+const SCHEDULE& InstrumentDriver<CHECKSUM>::statusSchedule(void) {
+    return status_schedule;
+}
+
+/**********************************************************************************************************************
+* Function      : void loopTimer()
+* Description   : Times loop() passes for the status packet, call once at the top of loop()
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::loopTimer(void) {
+    uint32_t now_us = micros();
+    uint32_t pass_us = now_us - loop_last_us;
+    if(loop_last_us != 0 && pass_us > loop_max_us) {
+        loop_max_us = pass_us;
+    }
+    loop_last_us = now_us;
+}
+
+/**********************************************************************************************************************
+* Function      : void latencyAdd(LAT_STAGE stage, uint32_t latency_us)
+* Description   : Counts one latency into the stage's histogram
+* Arguments     : LAT_STAGE stage, uint32_t latency_us
+* Returns       : none
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::latencyAdd(LAT_STAGE stage, uint32_t latency_us) {
+    LAT_HIST &hist = lat_hist[stage];
+    uint8_t bucket = latency_us == 0 ? 0 : 32 - __builtin_clz(latency_us);
+    if(bucket >= K_LAT_BUCKETS) {
+        bucket = K_LAT_BUCKETS - 1;
+    }
+    hist.buckets[bucket]++;
+    hist.count++;
+    hist.sum_us += latency_us;
+    if(latency_us > hist.max_us) {
+        hist.max_us = latency_us;
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : const LAT_HIST& latencyHist(LAT_STAGE stage)
+* Description   : Histogram of one stage since boot or latencyReset()
+* Arguments     : LAT_STAGE stage
+* Returns       : const LAT_HIST&
+**********************************************************************************************************************/
+template <class CHECKSUM>
+const LAT_HIST& InstrumentDriver<CHECKSUM>::latencyHist(LAT_STAGE stage) {
+    return lat_hist[stage];
+}
+
+/**********************************************************************************************************************
+* Function      : void latencyReset()
+* Description   : Clears every latency histogram
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::latencyReset(void) {
+    memset(lat_hist, 0, sizeof(lat_hist));
+}
+
+#ifndef ARDUINO
+/**********************************************************************************************************************
+* Function      : void latencyDump()
+* Description   : Prints every latency histogram to stdout
+* Arguments     : none
+* Returns       : none
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::latencyDump(void) {
+    static const char *names[LAT_STAGES] = {"rx", "dispatch", "execute", "drain", "turnaround"};
+    for(uint8_t stage = 0; stage < LAT_STAGES; stage++) {
+        const LAT_HIST &hist = lat_hist[stage];
+        printf("%-10s %u samples, %.1f us mean, %u us max\n", names[stage], hist.count,
+               hist.count ? (double)hist.sum_us / hist.count : 0.0, hist.max_us);
+        for(uint8_t bucket = 0; bucket < K_LAT_BUCKETS; bucket++) {
+            if(hist.buckets[bucket] == 0) {
+                continue;
+            }
+            uint32_t low_us = bucket == 0 ? 0 : 1u << (bucket - 1);
+            if(bucket == K_LAT_BUCKETS - 1) {
+                printf("    >= %7u us %10u\n", low_us, hist.buckets[bucket]);
+            }else {
+                printf("    %7u us+ %10u\n", low_us, hist.buckets[bucket]);
+            }
+        }
+    }
+}
+#endif
+
+/**********************************************************************************************************************
+* Function      : uint8_t* txAcquire()
+* Description   : Hands out the next free TX slot to build a TLM frame in
+* Arguments     : none
+* Returns       : uint8_t* - slot of K_TX_SLOT_SIZE bytes, NULL if the queue is full (counted as a drop)
+* Remarks       : The slot is only queued once sendData() is called
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint8_t* InstrumentDriver<CHECKSUM>::txAcquire(void) {
+    if(tx_count == K_TX_SLOTS) {
+        tx_dropped++;
+        return NULL;
+    }
+    return tx_slots[(tx_head + tx_count) % K_TX_SLOTS];
+}
+
+/**********************************************************************************************************************
+* Function      : void sendData(int pack_size)
+* Description   : Queues the TLM frame built in the slot from txAcquire()
+* Arguments     : int pack_size - size of the packet to be sent
+* Returns      : none
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::sendData(int pack_size) {
+    uint8_t slot = (tx_head + tx_count) % K_TX_SLOTS;
+    tx_slot_len[slot] = pack_size;
+    tx_slot_timed[slot] = lat_echo_next;
+    if(lat_echo_next) {
+        uint32_t now_us = micros();
+        latencyAdd(LAT_EXECUTE, now_us - lat_proc_us);
+        tx_slot_sync_us[slot] = lat_cmd_sync_us;
+        tx_slot_queued_us[slot] = now_us;
+        lat_echo_next = 0;
+    }
+    if(capture_log != NULL) {
+        captureAppend(capture_log, CAPTURE_TX, capture_source, tx_slots[slot], pack_size);
+    }
+    tx_count++;
+    if(tx_count > tx_high_water) {
+        tx_high_water = tx_count;
+    }
+    // Tiktok after every frame
+    instrumentUpdate(TOGGLE_HEART);
+}
+
+/**********************************************************************************************************************
+* Function      : void txDrain()
+* Description   : Writes queued TLM frames into the UART as far as its TX buffer has room
+* Arguments     : none
+* Returns      : none
+* Remarks       : Never blocks, call from loop(). A science frame on the wire is finished first, then housekeeping,
+*                 and science fills the line whenever the queue is empty. The next science frame is built here
+*                 while the current one goes out so the line never waits on it.
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::txDrain(void) {
+    while(true) {
+        int space = port.availableForWrite();
+        if(space <= 0) {
+            break;
+        }
+
+        if(sci_sending) {
+            // Write as much of the science frame as fits
+            uint16_t remaining = sci_len[sci_active] - sci_sent;
+            uint16_t chunk = remaining < space ? remaining : space;
+            chunk = port.write(&sci_buff[sci_active][sci_sent], chunk);
+            sci_sent += chunk;
+            tx_bytes += chunk;
+
+            if(sci_sent == sci_len[sci_active]) {
+                sci_sending = 0;
+                sci_frames_sent++;
+            }
+        }else if(tx_count > 0) {
+            // Write as much of the head slot as fits
+            uint16_t remaining = tx_slot_len[tx_head] - tx_sent;
+            uint16_t chunk = remaining < space ? remaining : space;
+            chunk = port.write(&tx_slots[tx_head][tx_sent], chunk);
+            tx_sent += chunk;
+            tx_bytes += chunk;
+
+            // Head slot done, free it
+            if(tx_sent == tx_slot_len[tx_head]) {
+                if(tx_slot_timed[tx_head]) {
+                    uint32_t now_us = micros();
+                    latencyAdd(LAT_DRAIN, now_us - tx_slot_queued_us[tx_head]);
+                    latencyAdd(LAT_TURNAROUND, now_us - tx_slot_sync_us[tx_head]);
+                }
+                tx_sent = 0;
+                tx_head = (tx_head + 1) % K_TX_SLOTS;
+                tx_count--;
+            }
+        }else if(!scienceStart()) {
+            break;
+        }
+    }
+
+    // Build the next science frame behind the one on the wire
+    if(!sci_ready && scienceSize() != 0) {
+        scienceBuild();
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : void captureAttach(CaptureHeader* log, uint8_t source)
+* Description   : Starts recording every chunk getData() reads and every frame sendData() queues into log
+* Arguments     : CaptureHeader* log - from captureInit(), NULL stops recording, uint8_t source - tags the records
+* Returns       : none
+* Remarks       : Several instruments may share one log. Science frames are not recorded, they are generated
+*                 from the frame count and would crowd everything else out of the ring.
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::captureAttach(CaptureHeader *log, uint8_t source) {
+    capture_log = log;
+    capture_source = source;
+}
+
+/**********************************************************************************************************************
+* Function      : uint8_t txQueueDepth()
+* Description   : TX queue counters
+* Arguments     : none
+* Returns       : txQueueDepth - slots queued now, txQueueHighWater - most slots ever queued,
+*                 txQueueDropped - frames dropped because the queue was full
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint8_t InstrumentDriver<CHECKSUM>::txQueueDepth(void) {
+    return tx_count;
+}
+
+template <class CHECKSUM>
+uint8_t InstrumentDriver<CHECKSUM>::txQueueHighWater(void) {
+    return tx_high_water;
+}
+
+template <class CHECKSUM>
+uint32_t InstrumentDriver<CHECKSUM>::txQueueDropped(void) {
+    return tx_dropped;
+}
+
+/**********************************************************************************************************************
+* Function      : uint32_t txBytesWritten()
+* Description   : Bytes of telemetry handed to the UART, wraps
+* Arguments     : none
+* Returns       : uint32_t
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint32_t InstrumentDriver<CHECKSUM>::txBytesWritten(void) {
+    return tx_bytes;
+}
+
+/**********************************************************************************************************************
+* Function      : uint16_t scienceSize()
+* Description   : Size of the science frames for the current mode
+* Arguments     : none
+* Returns       : uint16_t - burst length, survey length, or 0 when neither is enabled (padded to even)
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint16_t InstrumentDriver<CHECKSUM>::scienceSize(void) {
+    uint16_t pack_size = 0;
+    if(g_burst_enabled) {
+        pack_size = g_burst_len;
+    }else if(g_surv_enabled) {
+        pack_size = g_surv_len;
+    }
+    return (pack_size + 1) & ~0x01;
+}
+
+/**********************************************************************************************************************
+* Function      : void scienceBuild()
+* Description   : Builds the next science frame into the buffer that is not on the wire
+* Arguments     : none
+* Returns       : none
+* Remarks       : Payload is the frame count then a byte ramp seeded by it, so the ground can check every byte.
+*                 Science has its own sequence count, frames are built ahead of housekeeping that may go out
+*                 first. The heartbeat is left alone, it keeps ticking on housekeeping.
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::scienceBuild(void) {
+    uint16_t pack_size = scienceSize();
+    uint8_t *tlm_packet = sci_buff[sci_next];
+
+    // Header, then the science sequence count over the housekeeping one
+    memcpy(tlm_packet, SCIENCE_TEMPLATE, sizeof(SCIENCE_TEMPLATE));
+    tlmApid(&tlm_packet[6], tlm_apids.science);
+    tlmHeader(tlm_packet, pack_size);
+    sci_sequence_count = (sci_sequence_count + 1) & 0x3FFF;
+    tlm_packet[8] = 0xC0 | ((sci_sequence_count >> 8) & 0xFF);
+    tlm_packet[9] = sci_sequence_count & 0xFF;
+
+    // Length of packet after this byte - 1
+    int s_data_len = pack_size - 15;
+    tlm_packet[10] = (s_data_len >> 8) & 0xFF;
+    tlm_packet[11] = s_data_len & 0xFF;
+
+    // Frame count
+    tlm_packet[16] = (sci_frame_count >> 24) & 0xFF;
+    tlm_packet[17] = (sci_frame_count >> 16) & 0xFF;
+    tlm_packet[18] = (sci_frame_count >> 8) & 0xFF;
+    tlm_packet[19] = sci_frame_count & 0xFF;
+
+    // Ramp
+    uint8_t seed = sci_frame_count & 0xFF;
+    for(uint16_t i = K_SCIENCE_HEADER_SIZE; i < pack_size - 2; i++) {
+        tlm_packet[i] = (uint8_t)(seed + i);
+    }
+    sci_frame_count++;
+
+    // Checksum at end
+    uint16_t temp_check = CHECKSUM::update(CHECKSUM::seed, &tlm_packet[K_TLM_CRC_OFFSET],
+                                            pack_size - K_TLM_CRC_OFFSET - 2);
+    tlm_packet[pack_size - 2] = (temp_check >> 8) & 0xFF;
+    tlm_packet[pack_size - 1] = temp_check & 0xFF;
+
+    sci_len[sci_next] = pack_size;
+    sci_ready = 1;
+}
+
+/**********************************************************************************************************************
+* Function      : bool scienceStart()
+* Description   : Puts the next science frame on the wire, building it now if it isn't ready
+* Arguments     : none
+* Returns       : bool - false if science is off
+* Remarks       : A frame built before a mode change is thrown away and its sequence count taken back, so the
+*                 ground sees no gap
+**********************************************************************************************************************/
+template <class CHECKSUM>
+bool InstrumentDriver<CHECKSUM>::scienceStart(void) {
+    uint16_t pack_size = scienceSize();
+    if(sci_ready && sci_len[sci_next] != pack_size) {
+        sci_ready = 0;
+        sci_sequence_count = (sci_sequence_count - 1) & 0x3FFF;
+        sci_frame_count--;
+    }
+    if(pack_size == 0) {
+        return false;
+    }
+    if(!sci_ready) {
+        scienceBuild();
+    }
+
+    // Swap buffers
+    sci_active = sci_next;
+    sci_next ^= 0x01;
+    sci_ready = 0;
+    sci_sending = 1;
+    sci_sent = 0;
+    return true;
+}
+
+/**********************************************************************************************************************
+* Function      : uint32_t scienceFramesSent()
+* Description   : Science frames fully handed to the UART
+* Arguments     : none
+* Returns       : uint32_t
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint32_t InstrumentDriver<CHECKSUM>::scienceFramesSent(void) {
+    return sci_frames_sent;
+}
+
+/**********************************************************************************************************************
+* Function      : void linkBegin(uint32_t baud, LINK_FORMAT format)
+* Description   : Starts the instrument UART
+* Arguments     : uint32_t baud, LINK_FORMAT format
+* Returns       : none
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::linkBegin(uint32_t baud, LINK_FORMAT format) {
+    link_baud = baud;
+    link_format = format;
+    port.begin(baud, format);
+}
+
+/**********************************************************************************************************************
+* Function      : void linkService()
+* Description   : Applies a commanded link change once TX is idle, and ends the link self-test
+* Arguments     : none
+* Returns       : none
+* Remarks       : Call from loop() after txDrain(). flush() only waits out the bytes already in the UART.
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::linkService(void) {
+    if(link_pending && tx_count == 0 && !sci_sending) {
+        port.flush();
+        linkBegin(link_pending_baud, link_pending_format);
+        link_pending = 0;
+
+        // Anything part way in was sent at the old rate
+        reset();
+    }
+
+    if(link_test_running && micros() - link_test_start_us >= link_test_us) {
+        link_test_running = 0;
+        linkTestReport();
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : uint32_t linkBaud()
+* Description   : Link settings in use
+* Arguments     : none
+* Returns       : linkBaud - baud rate, linkFormat - framing, linkLineRate - bytes per second the line can carry
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint32_t InstrumentDriver<CHECKSUM>::linkBaud(void) {
+    return link_baud;
+}
+
+template <class CHECKSUM>
+LINK_FORMAT InstrumentDriver<CHECKSUM>::linkFormat(void) {
+    return link_format;
+}
+
+template <class CHECKSUM>
+uint32_t InstrumentDriver<CHECKSUM>::linkLineRate(void) {
+    return link_baud / K_LINK_FRAME_BITS[link_format];
+}
+
+/**********************************************************************************************************************
+* Function      : float linkUtilisation(uint32_t bytes, uint32_t elapsed_us)
+* Description   : Fraction of the line used by bytes sent over elapsed_us at the current link settings
+* Arguments     : uint32_t bytes, uint32_t elapsed_us
+* Returns       : float - 1.0 is every bit time busy
+**********************************************************************************************************************/
+template <class CHECKSUM>
+float InstrumentDriver<CHECKSUM>::linkUtilisation(uint32_t bytes, uint32_t elapsed_us) {
+    if(elapsed_us == 0) {
+        return 0.0f;
+    }
+    return ((float)bytes * K_LINK_FRAME_BITS[link_format] * 1e6f) / ((float)link_baud * elapsed_us);
+}
+
+/**********************************************************************************************************************
+* Function      : static RAM_REPORT ramReport()
+* Description   : Bytes each instrument takes, from the sizes the capacity macros give at compile time
+* Arguments     : none
+* Returns       : RAM_REPORT
+* Remarks       : The port line is the RX and TX memory SerialPort holds on the Teensy, not the host loopback
+**********************************************************************************************************************/
+template <class CHECKSUM>
+RAM_REPORT InstrumentDriver<CHECKSUM>::ramReport(void) {
+    RAM_REPORT report = {};
+    report.rx = sizeof(rx_buffs);
+    report.tx = sizeof(tx_slots) + sizeof(tx_slot_len) + sizeof(tx_slot_timed) + sizeof(tx_slot_sync_us) +
+                sizeof(tx_slot_queued_us);
+    report.science = sizeof(sci_buff) + sizeof(sci_len);
+    report.other = sizeof(InstrumentDriver) - report.rx - report.tx - report.science;
+    report.port = K_UART_RX_EXTRA + K_UART_TX_EXTRA;
+    report.total = sizeof(InstrumentDriver) + report.port;
+    return report;
+}
+
+/**********************************************************************************************************************
+* Function      : uint8_t* tlmBegin(const uint8_t* tlm_template, uint8_t template_size, int pack_size, uint16_t apid)
+* Description   : Starts a TLM frame in a free TX slot from a packet template
+* Arguments     : const uint8_t* tlm_template, uint8_t template_size - bytes to copy from template
+*                 int pack_size - size of the whole frame, uint16_t apid - this instrument's APID for the packet
+* Returns       : uint8_t* - frame to fill in, NULL if the queue is full (packet dropped)
+**********************************************************************************************************************/
+template <class CHECKSUM>
+uint8_t* InstrumentDriver<CHECKSUM>::tlmBegin(const uint8_t *tlm_template, uint8_t template_size, int pack_size,
+                                              uint16_t apid) {
+    // Get a free TX slot, drop the packet if the queue is full
+    uint8_t *tlm_packet = txAcquire();
+    if(tlm_packet == NULL) {
+        return NULL;
+    }
+
+    // Increase sequence count
+    instrumentUpdate(UPDATE_SEQUENCE);
+
+    // Initialize packet from template and fill in header
+    memcpy(tlm_packet, tlm_template, template_size);
+    tlmApid(&tlm_packet[6], apid);
+    tlmHeader(tlm_packet, pack_size);
+    return tlm_packet;
+}
+
+/**********************************************************************************************************************
+* Function      : void tlmHeader(uint8_t* tlm_packet, int pack_size)
+* Description   : Patches the fields that change between frames into a packet copied from a template
+* Arguments     : uint8_t* tlm_packet, int pack_size
+* Returns      : none
+* Remarks       : Sync, APID, grouping flags and any fixed CCSDS length come from the template
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::tlmHeader(uint8_t *tlm_packet, int pack_size) {
     // Alive, Power Down, Spare, Length (Aliveness toggled in sim)
-    int e_data_len = pack_size - K_INS_DATA_LEN_OFFSET;
-    tlm_packet[4] = i_heartbeat | i_power | ((e_data_len  >> 8) & 0xFF);
+    int data_len = pack_size - K_INS_DATA_LEN_OFFSET;
+    tlm_packet[4] = i_heartbeat | i_power | ((data_len >> 8) & 0xFF);
     // Length
-    tlm_packet[5] = e_data_len  & 0xFF;
-
-    // Echo Header
-    // Version, Type, Secondary, APID
-    int e_apid = 0x301;
-    tlm_packet[6] =  0x08 | ((e_apid >> 8) & 0x07);;
-    // APID
-    tlm_packet[7] = (e_apid & 0xFF);
+    tlm_packet[5] = data_len & 0xFF;
     // Grouping, Sequence Count: 11XXXXXX
     tlm_packet[8] = 0xC0 | ((i_sequence_count >> 8) & 0xFF);
     // Sequence Count: XXXXXXXX
     tlm_packet[9] = (i_sequence_count) & 0xFF;
-    // Length of packet after this byte:
-    e_data_len = pack_size - 12;
-    tlm_packet[10] = (e_data_len >> 8) & 0xFF;
-    tlm_packet[11] = e_data_len & 0xFF;
- 
     // Time tag (4 bytes) when command was executed
     tlm_packet[12] = (i_time >> 24) & 0xFF;
     tlm_packet[13] = (i_time >> 16) & 0xFF;
     tlm_packet[14] = (i_time >> 8) & 0xFF;
     tlm_packet[15] = i_time & 0xFF;
+}
+
+/**********************************************************************************************************************
+* Function      : void tlmSend(uint8_t* tlm_packet, int pack_size, int crc_offset, const TlmPrefix& prefix)
+* Description   : Writes the checksum and queues the frame
+* Arguments     : uint8_t* tlm_packet, int pack_size
+*                 int crc_offset - where the checksum goes, ahead of any padding byte
+*                 const TlmPrefix& prefix - precomputed checksum of bytes 4-7 for this packet type and size
+* Returns      : none
+* Remarks       : The checksum always covers bytes 4 to pack_size - 2
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::tlmSend(uint8_t *tlm_packet, int pack_size, int crc_offset, const TlmPrefix &prefix) {
+    // Checksum at end, picking up from the prefix for the current heartbeat and power
+    uint8_t flags = ((i_heartbeat >> 7) & 0x01) | ((i_power >> 5) & 0x02);
+    uint16_t temp_check = CHECKSUM::update(prefix.crc[flags], &tlm_packet[K_TLM_SEQUENCE_OFFSET],
+                                           pack_size - K_TLM_SEQUENCE_OFFSET - 2);
+
+    tlm_packet[crc_offset] = (temp_check >> 8) & 0xFF;
+    tlm_packet[crc_offset + 1] = temp_check;
+
+    sendData(pack_size);
+}
+
+/**********************************************************************************************************************
+* Function      : void tlmPut32(uint8_t* field, uint32_t value)
+* Description   : Writes a big endian 32 bit TLM field
+* Arguments     : uint8_t* field, uint32_t value
+* Returns       : none
+**********************************************************************************************************************/
+static inline void tlmPut32(uint8_t *field, uint32_t value) {
+    field[0] = (value >> 24) & 0xFF;
+    field[1] = (value >> 16) & 0xFF;
+    field[2] = (value >> 8) & 0xFF;
+    field[3] = value & 0xFF;
+}
+
+// 16 bit field, wrapping for counters
+static inline void tlmPut16(uint8_t *field, uint16_t value) {
+    field[0] = (value >> 8) & 0xFF;
+    field[1] = value & 0xFF;
+}
+
+// 16 bit field, saturating for times
+static inline void tlmPutSat16(uint8_t *field, uint32_t value) {
+    tlmPut16(field, value > 0xFFFF ? 0xFFFF : value);
+}
+
+/**********************************************************************************************************************
+* Function      : void status()
+* Description   : Builds a status packet on TLM frame, sent by statusService() every status period
+* Arguments     : none
+* Returns      : none
+* Remarks       : SOFTWARE section
+*                 102-105 RX bytes, 106-109 ITF frames accepted, 110-119 alarms raised by ALARM_STATE (2 bytes each),
+*                 120-123 commands executed, 124 TX queue high water, 125 TX queue depth, 126-127 TX frames dropped,
+*                 128-129 RX overruns, 130-131 longest loop() pass since the last status, 132-133 status lateness,
+*                 134-135 worst status lateness, 136-137 science frames sent
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::status() {
+    // Set pack_size (args 124 + header of 16)
+    int pack_size = StatusLayout::size;
+
+    uint8_t *tlm_packet = tlmBegin(STATUS_TEMPLATE, StatusLayout::size, pack_size, tlm_apids.status);
+    if(tlm_packet == NULL) {
+        return;
+    }
+
+    // FIXME: Arguments filled with dummy values
+    // ANALOG: 16-47
+    // DIGITAL: 48-101
+
+    // SOFTWARE: 102-137, counters from boot wrap, times in us saturate
+    tlmPut32(&tlm_packet[102], rx_bytes);
+    tlmPut32(&tlm_packet[106], rx_frames);
+    for(uint8_t type = 0; type < ALARM_TYPES; type++) {
+        tlmPut16(&tlm_packet[110 + 2 * type], alarm_counts[type]);
+    }
+    tlmPut32(&tlm_packet[120], cmd_executed);
+    tlm_packet[124] = tx_high_water;
+    tlm_packet[125] = tx_count;
+    tlmPut16(&tlm_packet[126], tx_dropped);
+    tlmPut16(&tlm_packet[128], port.rxOverruns());
+    tlmPutSat16(&tlm_packet[130], loop_max_us);
+    tlmPutSat16(&tlm_packet[132], status_schedule.late_us);
+    tlmPutSat16(&tlm_packet[134], status_schedule.late_max_us);
+    tlmPut16(&tlm_packet[136], sci_frames_sent);
+
+    // Longest loop() pass is per status
+    loop_max_us = 0;
+
+    // Send status packet
+    tlmSend(tlm_packet, pack_size, pack_size - 2, status_prefix);
+}
+
+/**********************************************************************************************************************
+* Function     : void echo(const CMD_DESC& cmd, uint8_t command_result)
+* Description  : Builds the simulated echo packet into TLM frame
+* Arguments    : const CMD_DESC& cmd - command in cmd_frame, uint8_t command_result
+* Returns      : none
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::echo(const CMD_DESC &cmd, uint8_t command_result) {
+    // Maxmimum aruments that can be sent
+    uint16_t arg_count = cmd.length;
+    if(arg_count > K_ECHO_MAX_ARGS){
+        arg_count = K_ECHO_MAX_ARGS;
+    }
+
+    // Set pack_size
+    int pack_size = arg_count + 20;
+
+    // Check if padding is needed
+    if(pack_size % 2 == 1) {
+        // Make the size even
+        pack_size ++;
+    }
+
+    uint8_t *tlm_packet = tlmBegin(ECHO_TEMPLATE, K_ECHO_HEADER_SIZE, pack_size, tlm_apids.echo);
+    if(tlm_packet == NULL) {
+        return;
+    }
+
+    // Length of packet after this byte:
+    int e_data_len = pack_size - 12;
+    tlm_packet[10] = (e_data_len >> 8) & 0xFF;
+    tlm_packet[11] = e_data_len & 0xFF;
 
     // Macro, Result
-    tlm_packet[16] = ((cmd_packets[cmd_location_head+1] & 0x01) << 7) | (command_result & 0x7F);
+    tlm_packet[16] = ((cmd.macro & 0x01) << 7) | (command_result & 0x7F);
     // Opcode
-    tlm_packet[17] = cmd_packets[cmd_location_head];
+    tlm_packet[17] = cmd.opcode;
     // Load Arguments
-    for(int i = 1; i <= arg_count; i ++){
-        tlm_packet[17 + i] = cmd_packets[cmd_location_head + 1 + i];
+    memcpy(&tlm_packet[18], &cmd_frame[cmd.offset + 2], arg_count);
+    // Clear CRC and padding, the padding byte is part of the checksum
+    memset(&tlm_packet[18 + arg_count], 0x00, pack_size - 18 - arg_count);
+
+    // Send echo packet
+    lat_echo_next = 1;
+    tlmSend(tlm_packet, pack_size, 18 + arg_count, echo_prefix.by_args[arg_count]);
+}
+
+/**********************************************************************************************************************
+* Function      : int echoPacket(uint8_t* ccsds, const CMD_DESC &cmd, uint8_t command_result)
+* Description   : Writes one echo CCSDS packet into an echo batch
+* Arguments     : uint8_t* ccsds - where the packet starts, const CMD_DESC &cmd, uint8_t command_result
+* Returns       : int - bytes written
+* Remarks       : Same fields as echo() from the APID on. The CCSDS length is the standard one (data bytes - 1) so
+*                 the ground can walk from packet to packet, there is no CRC or padding per packet.
+**********************************************************************************************************************/
+template <class CHECKSUM>
+int InstrumentDriver<CHECKSUM>::echoPacket(uint8_t *ccsds, const CMD_DESC &cmd, uint8_t command_result) {
+    // Maxmimum aruments that can be sent
+    uint16_t arg_count = cmd.length;
+    if(arg_count > K_ECHO_MAX_ARGS){
+        arg_count = K_ECHO_MAX_ARGS;
     }
 
-    // Checksum at end
-    int temp_check = CRC_SEED;
-    for (size_t i = 4; i < pack_size-2; i++) {
-        temp_check = crc(temp_check, tlm_packet[i]);
+    // Every packet in the batch has its own sequence count
+    instrumentUpdate(UPDATE_SEQUENCE);
+
+    tlmApid(&ccsds[0], tlm_apids.echo);
+    // Grouping, Sequence Count
+    ccsds[2] = 0xC0 | ((i_sequence_count >> 8) & 0xFF);
+    ccsds[3] = i_sequence_count & 0xFF;
+    // Length of packet after this byte - 1
+    int e_data_len = K_ECHO_CCSDS_HEADER_SIZE - 6 + arg_count - 1;
+    ccsds[4] = (e_data_len >> 8) & 0xFF;
+    ccsds[5] = e_data_len & 0xFF;
+    // Time tag
+    ccsds[6] = (i_time >> 24) & 0xFF;
+    ccsds[7] = (i_time >> 16) & 0xFF;
+    ccsds[8] = (i_time >> 8) & 0xFF;
+    ccsds[9] = i_time & 0xFF;
+    // Macro, Result
+    ccsds[10] = ((cmd.macro & 0x01) << 7) | (command_result & 0x7F);
+    // Opcode
+    ccsds[11] = cmd.opcode;
+    // Load Arguments
+    memcpy(&ccsds[12], &cmd_frame[cmd.offset + 2], arg_count);
+
+    return K_ECHO_CCSDS_HEADER_SIZE + arg_count;
+}
+
+/**********************************************************************************************************************
+* Function      : void echoBatchSend(uint8_t* tlm_packet, int pack_size)
+* Description   : Frames the echo packets in a TX slot with one sync, length and CRC and queues it
+* Arguments     : uint8_t* tlm_packet - slot with the packets from byte 6, int pack_size - bytes used so far
+* Returns       : none
+* Remarks       : A pad byte goes before the CRC when needed to keep the frame even
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::echoBatchSend(uint8_t *tlm_packet, int pack_size) {
+    // Pad and room for the checksum
+    if(pack_size % 2 == 1) {
+        tlm_packet[pack_size] = 0x00;
+        pack_size++;
     }
+    pack_size += 2;
 
-    tlm_packet[18 + arg_count] = (temp_check >> 8) & 0xFF;
-    tlm_packet[19 + arg_count] = temp_check;
+    // Sync
+    tlm_packet[0] = (SYNC >> 24) & 0xFF;
+    tlm_packet[1] = (SYNC >> 16) & 0xFF;
+    tlm_packet[2] = (SYNC >> 8) & 0xFF;
+    tlm_packet[3] = SYNC & 0xFF;
+    // Alive, Power Down, Spare, Length
+    int data_len = pack_size - K_INS_DATA_LEN_OFFSET;
+    tlm_packet[4] = i_heartbeat | i_power | ((data_len >> 8) & 0xFF);
+    tlm_packet[5] = data_len & 0xFF;
 
-    // Send echo packet
+    // Checksum at end
+    uint16_t temp_check = CHECKSUM::update(CHECKSUM::seed, &tlm_packet[K_TLM_CRC_OFFSET],
+                                            pack_size - K_TLM_CRC_OFFSET - 2);
+    tlm_packet[pack_size - 2] = (temp_check >> 8) & 0xFF;
+    tlm_packet[pack_size - 1] = temp_check & 0xFF;
+
+    // One frame, one heartbeat
+    lat_echo_next = 1;
     sendData(pack_size);
 }
 
 /**********************************************************************************************************************
 * Function      : void alarm()
-* Description   : Builds alarm packet and sends into TLM frame
+* Description   : Counts an alarm and sends it as alarm_mode allows
 * Arguments     : ALARM_STATE alarm_type
 * Returns       : none
+* Remarks       : Noise inside an ITF can raise an alarm every few bytes. Coalesced, they go out as one packet per
+*                 type. Immediate, the token bucket caps them and the rest ride on the next packet of their type.
 **********************************************************************************************************************/
-void alarm(ALARM_STATE alarm_type) {
-    // Verifies old tlm has sent before replacing tlm packet
-    Serial2.flush();
-    
-    // Increase sequence count
-    instrumentUpdate(UPDATE_SEQUENCE);
-    
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::alarm(ALARM_STATE alarm_type) {
+    alarm_counts[alarm_type]++;
+    alarm_pending[alarm_type]++;
+
+    // A full count goes out in either mode
+    if(alarm_mode == ALARM_IMMEDIATE || alarm_pending[alarm_type] >= K_ALARM_COUNT_MAX) {
+        alarmSend(alarm_type);
+    }
+}
+
+/**********************************************************************************************************************
+* Function      : bool alarmSend(ALARM_STATE alarm_type)
+* Description   : Builds an alarm packet for the occurrences of a type not yet sent and queues it
+* Arguments     : ALARM_STATE alarm_type
+* Returns       : bool - false if nothing was queued
+* Remarks       : Without a TX slot or a token the count is kept for the next try. A packet carries at most
+*                 K_ALARM_COUNT_MAX occurrences, the rest stay pending for the next one, so nothing is dropped.
+**********************************************************************************************************************/
+template <class CHECKSUM>
+bool InstrumentDriver<CHECKSUM>::alarmSend(ALARM_STATE alarm_type) {
+    if(tx_count == K_TX_SLOTS || (alarm_mode == ALARM_IMMEDIATE && !alarmToken())) {
+        return false;
+    }
+
     // Set pack_size
-    int pack_size = 22;
+    int pack_size = AlarmLayout::size;
 
-    // Initialize packet
-    memset(tlm_packet, 0x00, K_MAX_TLM_SIZE);
+    uint8_t *tlm_packet = tlmBegin(ALARM_TEMPLATE, AlarmLayout::size, pack_size, tlm_apids.alarm);
+    if(tlm_packet == NULL) {
+        return false;
+    }
 
-    // Telemetry ITF Header
-    // Sync
-    tlm_packet[0] = 0xFE;
-    tlm_packet[1] = 0xFA;
-    tlm_packet[2] = 0x30;
-    tlm_packet[3] = 0xC8;
-    // Alive, Power Down, Spare, Length (Aliveness toggled in sim)
-    int a_data_len = pack_size - K_INS_DATA_LEN_OFFSET;
-    tlm_packet[4] = i_heartbeat | i_power | ((a_data_len  >> 8) & 0xFF);
-    // Length
-    tlm_packet[5] = a_data_len  & 0xFF;
+    // Value, ALARM_STATE is in the same order as the alarm values
+    uint8_t count = alarm_pending[alarm_type] < K_ALARM_COUNT_MAX ? alarm_pending[alarm_type] : K_ALARM_COUNT_MAX;
+    tlm_packet[18] = 0x01 + alarm_type;
+    tlm_packet[19] = count;
+    alarm_pending[alarm_type] -= count;
 
-    // Alarm Header
-    // Version, Type, Secondary, APID
-    int a_apid = 0x302;
-    tlm_packet[6] =  0x08 | ((a_apid >> 8) & 0x07);;
-    // APID
-    tlm_packet[7] = (a_apid & 0xFF);
-    // Grouping, Sequence Count: 11XXXXXX
-    tlm_packet[8] = 0xC0 | ((i_sequence_count >> 8) & 0xFF);
-    // Sequence Count: XXXXXXXX
-    tlm_packet[9] = (i_sequence_count) & 0xFF;
-    // Length of packet after this byte - 1:
-    a_data_len = 7;
-    tlm_packet[10] = (a_data_len >> 8) & 0xFF;
-    tlm_packet[11] = a_data_len & 0xFF;
- 
-    // Time tag (4 bytes) when command was executed
-    tlm_packet[12] = (i_time >> 24) & 0xFF;
-    tlm_packet[13] = (i_time >> 16) & 0xFF;
-    tlm_packet[14] = (i_time >> 8) & 0xFF;
-    tlm_packet[15] = i_time & 0xFF;
-   
-    // Alarm ID
-    tlm_packet[16] = 0x01;
-    // Type
-    tlm_packet[17] = 0x01;
-   
-    switch(alarm_type){
-        case ITF_LENGTH:
-            // Value
-            tlm_packet[18] = 0x01;
-        break;
+    // Send alarm packet
+    tlmSend(tlm_packet, pack_size, pack_size - 2, alarm_prefix);
+    return true;
+}
 
-        case ITF_CHECKSUM:
-            // Value
-            tlm_packet[18] = 0x02;
-        break;
+/**********************************************************************************************************************
+* Function      : void alarmFlush()
+* Description   : Sends every type with occurrences not yet sent
+* Arguments     : none
+* Returns       : none
+* Remarks       : A type held over K_ALARM_COUNT_MAX takes as many packets as TX and the bucket allow
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::alarmFlush(void) {
+    for(uint8_t type = 0; type < ALARM_TYPES; type++) {
+        while(alarm_pending[type] > 0) {
+            if(!alarmSend((ALARM_STATE)type)) {
+                break;
+            }
+        }
+    }
+}
 
-        case CCSDS_FORMAT:
-            // Value
-            tlm_packet[18] = 0x03;
-        break;
+/**********************************************************************************************************************
+* Function      : void alarmService()
+* Description   : Sends coalesced alarms when their window is up, and immediate ones held back once tokens refill
+* Arguments     : none
+* Returns       : none
+* Remarks       : A commanded mode change is applied here, counts held under the old mode are sent first and the
+*                 bucket starts full
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::alarmService(void) {
+    if(alarm_mode_pending) {
+        alarmFlush();
+
+        uint32_t now_us = micros();
+        alarm_mode = alarm_pending_mode;
+        if(alarm_mode == ALARM_COALESCE) {
+            scheduleStart(alarm_schedule, alarm_pending_period_us, now_us);
+        }else {
+            alarm_token_us = alarm_pending_period_us;
+            alarm_tokens = K_ALARM_BURST;
+            alarm_refill_us = now_us;
+        }
+        alarm_mode_pending = 0;
+    }
 
-        case CCSDS_APID:
-            // Value
-            tlm_packet[18] = 0x04;
-        break;
+    if(alarm_mode == ALARM_IMMEDIATE || scheduleDue(alarm_schedule, micros()) > 0) {
+        alarmFlush();
+    }
+}
 
-        case CCSDS_LENGTH:
-            // Value
-            tlm_packet[18] = 0x05;
-        break;
-   }
+/**********************************************************************************************************************
+* Function      : bool alarmToken()
+* Description   : Takes a token from the immediate alarm bucket
+* Arguments     : none
+* Returns       : bool - false if the bucket is empty
+* Remarks       : One token per alarm_token_us up to K_ALARM_BURST, time spent full is not banked
+**********************************************************************************************************************/
+template <class CHECKSUM>
+bool InstrumentDriver<CHECKSUM>::alarmToken(void) {
+    if(alarm_token_us == 0) {
+        return true;
+    }
 
-    // Auxillary
-    tlm_packet[19] = 0x00;
+    uint32_t now_us = micros();
+    uint32_t refills = (now_us - alarm_refill_us) / alarm_token_us;
+    if(alarm_tokens + refills >= K_ALARM_BURST) {
+        alarm_tokens = K_ALARM_BURST;
+        alarm_refill_us = now_us;
+    }else {
+        alarm_tokens += refills;
+        alarm_refill_us += refills * alarm_token_us;
+    }
 
-    // Checksum at end
-    int temp_check = CRC_SEED;
-    for (size_t i = 4; i < pack_size-2; i++) {
-        temp_check = crc(temp_check, tlm_packet[i]);
+    if(alarm_tokens == 0) {
+        return false;
     }
+    alarm_tokens--;
+    return true;
+}
+
+/**********************************************************************************************************************
+* Function      : void latencyReport()
+* Description   : Sends one diagnostics packet per latency stage
+* Arguments     : none
+* Returns       : none
+* Remarks       : Histograms run from boot so a lost packet loses nothing, the ground differences them
+*                 16 LAT_STAGE, 17 bucket count, 18-21 samples, 22-25 max us, 26-29 mean us, 30- buckets (4 bytes each)
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::latencyReport(void) {
+    for(uint8_t stage = 0; stage < LAT_STAGES; stage++) {
+        const LAT_HIST &hist = lat_hist[stage];
+
+        int pack_size = DiagLayout::size;
+        uint8_t *tlm_packet = tlmBegin(DIAG_TEMPLATE, K_TLM_HEADER_SIZE, pack_size, tlm_apids.diag);
+        if(tlm_packet == NULL) {
+            return;
+        }
 
-    tlm_packet[20] = (temp_check >> 8) & 0xFF;
-    tlm_packet[21] = temp_check;
+        tlm_packet[16] = stage;
+        tlm_packet[17] = K_LAT_BUCKETS;
+        tlmPut32(&tlm_packet[18], hist.count);
+        tlmPut32(&tlm_packet[22], hist.max_us);
+        tlmPut32(&tlm_packet[26], hist.count ? (uint32_t)(hist.sum_us / hist.count) : 0);
+        for(uint8_t bucket = 0; bucket < K_LAT_BUCKETS; bucket++) {
+            tlmPut32(&tlm_packet[30 + 4 * bucket], hist.buckets[bucket]);
+        }
 
-    // Send alarm packet
-    sendData(pack_size);
+        // Send diagnostics packet
+        tlmSend(tlm_packet, pack_size, pack_size - 2, diag_prefix);
+    }
 }
+
+/**********************************************************************************************************************
+* Function      : void linkTestReport()
+* Description   : Sends the link self-test results
+* Arguments     : none
+* Returns       : none
+* Remarks       : Counts are over the test window, rates are per second of it
+*                 16-19 baud, 20 LINK_FORMAT, 21 spare, 22-25 window in ms, 26-29 RX frames, 30-33 RX bytes,
+*                 34-37 TX bytes, 38-41 RX frames/s, 42-45 TX bytes/s, 46-49 RX overruns, 50-53 CRC failures,
+*                 54-57 TX frames dropped
+**********************************************************************************************************************/
+template <class CHECKSUM>
+void InstrumentDriver<CHECKSUM>::linkTestReport(void) {
+    // Window counts before the report takes a slot and adds to them
+    uint32_t window_us = micros() - link_test_start_us;
+    uint32_t frames = rx_frames - link_test_rx_frames;
+    uint32_t rx_count = rx_bytes - link_test_rx_bytes;
+    uint32_t tx_count_bytes = tx_bytes - link_test_tx_bytes;
+    uint32_t overruns = port.rxOverruns() - link_test_overruns;
+    uint32_t crc_failures = rx_crc_failures - link_test_crc_failures;
+    uint32_t dropped = tx_dropped - link_test_tx_dropped;
+
+    int pack_size = LinkLayout::size;
+    uint8_t *tlm_packet = tlmBegin(LINK_TEMPLATE, K_TLM_HEADER_SIZE, pack_size, tlm_apids.link);
+    if(tlm_packet == NULL) {
+        return;
+    }
+
+    tlmPut32(&tlm_packet[16], link_baud);
+    tlm_packet[20] = link_format;
+    tlm_packet[21] = 0x00;
+    tlmPut32(&tlm_packet[22], window_us / 1000);
+    tlmPut32(&tlm_packet[26], frames);
+    tlmPut32(&tlm_packet[30], rx_count);
+    tlmPut32(&tlm_packet[34], tx_count_bytes);
+    tlmPut32(&tlm_packet[38], (uint32_t)((uint64_t)frames * 1000000 / window_us));
+    tlmPut32(&tlm_packet[42], (uint32_t)((uint64_t)tx_count_bytes * 1000000 / window_us));
+    tlmPut32(&tlm_packet[46], overruns);
+    tlmPut32(&tlm_packet[50], crc_failures);
+    tlmPut32(&tlm_packet[54], dropped);
+
+    // Send link packet
+    tlmSend(tlm_packet, pack_size, pack_size - 2, link_prefix);
+}
+
+/********************
+Instantiations
+*********************/
+// The sketch only carries the policy it was built with, the host builds every one for the benches
+#ifdef ARDUINO
+template class InstrumentDriver<INSTRUMENT_CHECKSUM>;
+#else
+template class InstrumentDriver<ChecksumBasic>;
+template class InstrumentDriver<ChecksumCrcTable>;
+template class InstrumentDriver<ChecksumCrcSlice>;
+template class InstrumentDriver<ChecksumNone>;
+#endif
@@ -15,8 +15,68 @@ Includes
 /********************
 Global Constants
 *********************/
-// Packet structure
-const int baud_rate = 115200;  // baud rate
+const uint32_t link_report_ms = 10000;  // Link utilisation report period over USB
+
+// Instruments served, one per UART, override with -DINSTRUMENT_COUNT=
+#ifndef INSTRUMENT_COUNT
+#define INSTRUMENT_COUNT 1
+#endif
+static_assert(INSTRUMENT_COUNT >= 1 && INSTRUMENT_COUNT <= 8, "Teensy 4.1 has 8 UARTs");
+
+// Bytes of PSRAM for the RX/TX capture ring, 0 leaves it off, override with -DINSTRUMENT_CAPTURE=
+#ifndef INSTRUMENT_CAPTURE
+#define INSTRUMENT_CAPTURE 0
+#endif
+
+/********************
+Structures
+*********************/
+// An instrument and the UART it answers on
+typedef struct InstrumentSlot {
+  SerialPort port;
+  InstrumentSim sim;
+
+  InstrumentSlot(HardwareSerial &uart, IMXRT_LPUART_t &lpuart, uint16_t apid_base)
+    : port(uart, lpuart), sim(port, instrumentApids(apid_base)) {}
+} InstrumentSlot;
+
+/********************
+Global Variables
+*********************/
+// Serial2 keeps APIDs 0x301-0x307, each further instrument moves its telemetry up by 0x10
+InstrumentSlot slots[INSTRUMENT_COUNT] = {
+  {Serial2, IMXRT_LPUART4, K_APID_BASE},
+#if INSTRUMENT_COUNT > 1
+  {Serial1, IMXRT_LPUART6, K_APID_BASE + 0x10},
+#endif
+#if INSTRUMENT_COUNT > 2
+  {Serial3, IMXRT_LPUART2, K_APID_BASE + 0x20},
+#endif
+#if INSTRUMENT_COUNT > 3
+  {Serial4, IMXRT_LPUART3, K_APID_BASE + 0x30},
+#endif
+#if INSTRUMENT_COUNT > 4
+  {Serial5, IMXRT_LPUART8, K_APID_BASE + 0x40},
+#endif
+#if INSTRUMENT_COUNT > 5
+  {Serial6, IMXRT_LPUART1, K_APID_BASE + 0x50},
+#endif
+#if INSTRUMENT_COUNT > 6
+  {Serial7, IMXRT_LPUART7, K_APID_BASE + 0x60},
+#endif
+#if INSTRUMENT_COUNT > 7
+  {Serial8, IMXRT_LPUART5, K_APID_BASE + 0x70},
+#endif
+};
+
+uint32_t link_last_ms = 0;
+uint32_t link_last_bytes[INSTRUMENT_COUNT] = {0};
+uint32_t link_last_frames[INSTRUMENT_COUNT] = {0};
+
+#if INSTRUMENT_CAPTURE
+// Needs PSRAM fitted, read back over the debugger or dumped after a run
+EXTMEM uint32_t capture_mem[INSTRUMENT_CAPTURE / sizeof(uint32_t)];
+#endif
 
 /**********************************************************************************************************************
 * Function      : void setup()
@@ -24,11 +84,64 @@ const int baud_rate = 115200;  // baud rate
 * Arguments     : none
 **************************************Gpi********************************************************************************/
 void setup() {
-  // Setup serial connection
-  Serial2.begin(baud_rate, SERIAL_8O1); // Data = 8 bits, Parity = odd parity, Stop bits = 1
+  // Setup serial connections, 8O1 at 115200 unless built with INSTRUMENT_BAUD and INSTRUMENT_FORMAT
+  for(InstrumentSlot &slot : slots) {
+    slot.sim.linkBegin(INSTRUMENT_BAUD, INSTRUMENT_FORMAT);
+  }
 
-  // Build a lookup table for CRC
-  buildCRC();
+  // USB for link reports
+  Serial.begin(115200);
+
+  // Footprint for the capacity this was built with, all of it static
+  RAM_REPORT ram = InstrumentSim::ramReport();
+  Serial.printf("ram: %lu bytes per instrument (rx %lu, tx %lu, science %lu, other %lu, port %lu), %lu for %u\n",
+                (unsigned long)ram.total, (unsigned long)ram.rx, (unsigned long)ram.tx, (unsigned long)ram.science,
+                (unsigned long)ram.other, (unsigned long)ram.port, (unsigned long)ram.total * INSTRUMENT_COUNT,
+                INSTRUMENT_COUNT);
+
+  // MET and status run off micros() from here
+  for(InstrumentSlot &slot : slots) {
+    slot.sim.statusBegin();
+  }
+
+#if INSTRUMENT_CAPTURE
+  // One ring for every instrument, records carry the slot they came from
+  CaptureHeader *capture = captureInit(capture_mem, sizeof(capture_mem));
+  for(uint8_t i = 0; i < INSTRUMENT_COUNT; i++) {
+    slots[i].sim.captureAttach(capture, i);
+  }
+#endif
+}
+
+/**********************************************************************************************************************
+* Function      : void usbReport()
+* Description   : Prints TLM throughput against the line rate and status jitter over USB every link_report_ms, one
+*                 pair of lines per instrument
+* Arguments     : none
+**********************************************************************************************************************/
+void usbReport() {
+  uint32_t now_ms = millis();
+  if(now_ms - link_last_ms < link_report_ms) {
+    return;
+  }
+
+  uint32_t elapsed_ms = now_ms - link_last_ms;
+  for(uint8_t i = 0; i < INSTRUMENT_COUNT; i++) {
+    InstrumentSim &sim = slots[i].sim;
+    uint32_t bytes = sim.txBytesWritten() - link_last_bytes[i];
+    uint32_t frames = sim.scienceFramesSent() - link_last_frames[i];
+    Serial.printf("link %u: %lu baud, %.0f B/s of %lu B/s (%.1f%%), %lu science frames\n", i,
+                  (unsigned long)sim.linkBaud(), bytes * 1000.0f / elapsed_ms, (unsigned long)sim.linkLineRate(),
+                  100.0f * sim.linkUtilisation(bytes, elapsed_ms * 1000UL), (unsigned long)frames);
+    const SCHEDULE &status_sched = sim.statusSchedule();
+    Serial.printf("status %u: %lu sent, late %lu us max, %.1f us mean, %lu missed\n", i,
+                  (unsigned long)status_sched.ticks, (unsigned long)status_sched.late_max_us,
+                  status_sched.ticks ? (float)status_sched.late_sum_us / status_sched.ticks : 0.0f,
+                  (unsigned long)status_sched.missed);
+    link_last_bytes[i] += bytes;
+    link_last_frames[i] += frames;
+  }
+  link_last_ms = now_ms;
 }
 
 /**********************************************************************************************************************
@@ -37,6 +150,10 @@ void setup() {
 * Arguments     : none
 **********************************************************************************************************************/
 void loop() {
-  // Continually check for data input
-  getData();
+  // Each instrument gets a full pass in turn
+  for(InstrumentSlot &slot : slots) {
+    slot.sim.service();
+  }
+
+  usbReport();
 }